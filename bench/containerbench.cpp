@@ -0,0 +1,187 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+#include <QTextStream>
+#include <QStringList>
+#include <QThread>
+#include <QAtomicInt>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+
+#include "containerbench.h"
+#include "helpers.h"
+
+#define KEYS 10000
+#define MSECS 1000
+#define QUEUEENTRIES 20000
+
+using namespace DFM;
+
+namespace
+{
+
+template <typename Hash>
+class Reader : public QThread
+{
+public:
+    Reader(Hash *hash, const QStringList &keys, QAtomicInt *stop)
+        : m_hash(hash), m_keys(keys), m_stop(stop), m_ops(0) {}
+    inline qint64 ops() const { return m_ops; }
+
+protected:
+    void run()
+    {
+        const int n = m_keys.count();
+        for (int i = 0; !m_stop->fetchAndAddRelaxed(0); ++i)
+        {
+            //a few lookups per check of the flag, like a paint pass
+            for (int j = 0; j < 64; ++j)
+                m_hash->value(m_keys.at((i*64+j) % n), 0);
+            m_ops += 64;
+        }
+    }
+
+private:
+    Hash *m_hash;
+    const QStringList &m_keys;
+    QAtomicInt *m_stop;
+    qint64 m_ops;
+};
+
+template <typename Hash>
+class Writer : public QThread
+{
+public:
+    Writer(Hash *hash, const QStringList &keys, QAtomicInt *stop)
+        : m_hash(hash), m_keys(keys), m_stop(stop), m_ops(0) {}
+    inline qint64 ops() const { return m_ops; }
+
+protected:
+    void run()
+    {
+        //the loader dropping stale data and storing the new
+        const int n = m_keys.count();
+        for (int i = 0; !m_stop->fetchAndAddRelaxed(0); ++i)
+        {
+            const QString &key = m_keys.at(i % n);
+            m_hash->destroy(key);
+            m_hash->insert(key, new int(i));
+            ++m_ops;
+        }
+    }
+
+private:
+    Hash *m_hash;
+    const QStringList &m_keys;
+    QAtomicInt *m_stop;
+    qint64 m_ops;
+};
+
+}
+
+ContainerBench::ContainerBench(const int keys, const int msecs)
+    : m_keys(keys)
+    , m_msecs(msecs)
+{
+}
+
+template <typename Hash>
+ContainerBench::Result
+ContainerBench::contend(const int readers) const
+{
+    QStringList keys;
+    for (int i = 0; i < m_keys; ++i)
+        keys << QString("/home/user/some/folder/file%1.txt").arg(i);
+
+    Hash hash;
+    for (int i = 0; i < keys.count(); ++i)
+        hash.insert(keys.at(i), new int(i));
+
+    QAtomicInt stop(0);
+    QList<Reader<Hash> *> r;
+    for (int i = 0; i < readers; ++i)
+        r << new Reader<Hash>(&hash, keys, &stop);
+    Writer<Hash> w(&hash, keys, &stop);
+    for (int i = 0; i < r.count(); ++i)
+        r.at(i)->start();
+    w.start();
+    QMutex mutex;
+    QWaitCondition sleep;
+    mutex.lock();
+    sleep.wait(&mutex, m_msecs);
+    mutex.unlock();
+    stop.fetchAndStoreRelaxed(1);
+
+    Result res = { 0, 0 };
+    for (int i = 0; i < r.count(); ++i)
+    {
+        r.at(i)->wait();
+        res.reads += r.at(i)->ops();
+        delete r.at(i);
+    }
+    w.wait();
+    res.writes = w.ops();
+    for (int i = 0; i < keys.count(); ++i)
+        hash.destroy(keys.at(i));
+    return res;
+}
+
+template <typename Queue>
+qint64
+ContainerBench::fillAndDrain(const int entries) const
+{
+    //every entry is offered twice, the second one is a dupe
+    QElapsedTimer timer;
+    timer.start();
+    Queue queue;
+    for (int i = 0; i < entries; ++i)
+    {
+        const QString &file = QString("/home/user/some/folder/file%1.txt").arg(i);
+        queue.enqueue(file);
+        queue.enqueue(file);
+    }
+    QString file;
+    while (queue.dequeue(file));
+    return timer.elapsed();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    ContainerBench bench(KEYS, MSECS);
+    QTextStream out(stdout);
+    out << "hash, " << KEYS << " keys, one writer, " << MSECS << "ms per run\n";
+    out << "readers\tmutex reads/s\tmutex writes/s\tsharded reads/s\tsharded writes/s\n";
+    const int maxReaders = qMax(2, QThread::idealThreadCount());
+    for (int readers = 1; readers <= maxReaders; readers *= 2)
+    {
+        const ContainerBench::Result &m = bench.contend<MutexHash<QString, int *> >(readers);
+        const ContainerBench::Result &s = bench.contend<DHash<QString, int *> >(readers);
+        out << readers << "\t" << m.reads*1000/MSECS << "\t" << m.writes*1000/MSECS
+            << "\t" << s.reads*1000/MSECS << "\t" << s.writes*1000/MSECS << "\n";
+        out.flush();
+    }
+    out << "queue, " << QUEUEENTRIES << " entries offered twice then drained\n";
+    out << "mutex queue (ms)\tset queue (ms)\n";
+    out << bench.fillAndDrain<MutexQueue<QString> >(QUEUEENTRIES) << "\t"
+        << bench.fillAndDrain<DQueue<QString> >(QUEUEENTRIES) << "\n";
+    return 0;
+}
@@ -0,0 +1,81 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+
+#ifndef CONTAINERBENCH_H
+#define CONTAINERBENCH_H
+
+#include <QMutex>
+#include <QHash>
+#include <QQueue>
+#include <QString>
+
+namespace DFM
+{
+
+/* Hammers the thread-safe containers from helpers.h
+ * the way the data loader does, readers looking up
+ * entries while a writer inserts and destroys them,
+ * and reports throughput next to the plain one mutex
+ * per container wrappers they replaced.
+ */
+
+//the old wrappers, kept here to compare against
+template <typename Key, typename Val>
+class MutexHash
+{
+public:
+    void insert(const Key &key, Val val)            { QMutexLocker locker(&m_mutex); m_hash.insert(key, val); }
+    Val value(const Key &key, Val defaultValue)     { QMutexLocker locker(&m_mutex); return m_hash.value(key, defaultValue); }
+    bool contains(const Key &key)                   { QMutexLocker locker(&m_mutex); return m_hash.contains(key); }
+    void destroy(const Key &key)                    { QMutexLocker locker(&m_mutex); if (m_hash.contains(key)) delete m_hash.take(key); }
+
+private:
+    QMutex m_mutex;
+    QHash<Key, Val> m_hash;
+};
+
+template <typename T>
+class MutexQueue
+{
+public:
+    bool enqueue(const T &t)                { QMutexLocker locker(&m_mutex); if (m_queue.contains(t)) return false; m_queue.enqueue(t); return true; }
+    bool dequeue(T &t)                      { QMutexLocker locker(&m_mutex); if (m_queue.isEmpty()) return false; t = m_queue.dequeue(); return true; }
+
+private:
+    QMutex m_mutex;
+    QQueue<T> m_queue;
+};
+
+class ContainerBench
+{
+public:
+    struct Result { qint64 reads, writes; };
+    explicit ContainerBench(const int keys, const int msecs);
+    template <typename Hash> Result contend(const int readers) const;
+    template <typename Queue> qint64 fillAndDrain(const int entries) const;
+
+private:
+    int m_keys, m_msecs;
+};
+
+}
+
+#endif // CONTAINERBENCH_H
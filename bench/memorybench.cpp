@@ -0,0 +1,113 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+#include <QTextStream>
+#include <QStringList>
+#include <QUrl>
+
+#include "memorybench.h"
+#include "application.h"
+#include "fsmodel.h"
+#include "fsnode.h"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#define DIRSIZE 1000
+
+using namespace DFM;
+
+MemoryBench::MemoryBench(const int entries)
+    : m_entries(entries)
+    , m_bytes(0)
+    , m_model(new FS::Model())
+    , m_root(0)
+{
+}
+
+MemoryBench::~MemoryBench()
+{
+    delete m_root;
+    delete m_model;
+}
+
+qint64
+MemoryBench::heapUsed()
+{
+#if defined(HASMALLINFO2)
+    const struct mallinfo2 mi = mallinfo2();
+    return qint64(mi.uordblks) + qint64(mi.hblkhd);
+#elif defined(__GLIBC__)
+    const struct mallinfo mi = mallinfo();
+    return qint64(uint(mi.uordblks)) + qint64(uint(mi.hblkhd));
+#else
+    return 0;
+#endif
+}
+
+void
+MemoryBench::run()
+{
+    const QString base("/dfm-memorybench-does-not-exist");
+    const qint64 before = heapUsed();
+    m_root = new FS::Node(m_model, QUrl::fromLocalFile(base), 0, base);
+    FS::Node *dir = 0;
+    int made = 0;
+    for (int d = 0; made < m_entries; ++d)
+    {
+        const QString &dirPath = QString("%1/dir%2").arg(base).arg(d, 5, 10, QChar('0'));
+        dir = new FS::Node(m_model, QUrl::fromLocalFile(dirPath), m_root, dirPath);
+        ++made;
+        //batched like a real populate, one insert per dir
+        dir->startBatch();
+        for (int f = 0; f < DIRSIZE && made < m_entries; ++f, ++made)
+        {
+            const QString &filePath = QString("%1/file%2.txt").arg(dirPath).arg(f, 4, 10, QChar('0'));
+            new FS::Node(m_model, QUrl::fromLocalFile(filePath), dir, filePath);
+        }
+        dir->endBatch();
+    }
+    m_bytes = heapUsed()-before;
+}
+
+int main(int argc, char *argv[])
+{
+    Application app(argc, argv);
+
+    QList<int> sizes;
+    for (int i = 1; i < app.arguments().count(); ++i)
+        if (const int size = app.arguments().at(i).toInt())
+            sizes << size;
+    if (sizes.isEmpty())
+        sizes << 1000000;
+
+    QTextStream out(stdout);
+    out << "sizeof(FS::Node): " << sizeof(FS::Node) << "\n";
+    out << "entries\theap (bytes)\tbytes per node\n";
+    for (int i = 0; i < sizes.count(); ++i)
+    {
+        MemoryBench bench(sizes.at(i));
+        bench.run();
+        out << sizes.at(i) << "\t" << bench.bytes() << "\t" << bench.bytesPerNode() << "\n";
+        out.flush();
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+
+#ifndef MEMORYBENCH_H
+#define MEMORYBENCH_H
+
+#include <QtGlobal>
+#include <QString>
+
+namespace DFM
+{
+namespace FS { class Model; class Node; }
+
+/* Builds a synthetic tree of FS::Nodes, dirs of
+ * a thousand files each, and reports how much
+ * heap it takes per node. Nothing is created on
+ * disk, the paths dont exist. Run it on two
+ * revisions to compare node footprints.
+ */
+
+class MemoryBench
+{
+public:
+    explicit MemoryBench(const int entries);
+    ~MemoryBench();
+    void run();
+    inline qint64 bytes() const { return m_bytes; }
+    inline double bytesPerNode() const { return m_entries ? double(m_bytes)/m_entries : 0.0; }
+
+protected:
+    static qint64 heapUsed();
+
+private:
+    int m_entries;
+    qint64 m_bytes;
+    FS::Model *m_model;
+    FS::Node *m_root;
+};
+
+}
+
+#endif // MEMORYBENCH_H
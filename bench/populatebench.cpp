@@ -0,0 +1,148 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+#include <QDir>
+#include <QFile>
+#include <QEventLoop>
+#include <QTimer>
+#include <QStringList>
+#include <QTextStream>
+
+#include "populatebench.h"
+#include "application.h"
+#include "fsmodel.h"
+
+using namespace DFM;
+
+PopulateBench::PopulateBench(const int entries, QObject *parent)
+    : QObject(parent)
+    , m_entries(entries)
+    , m_model(0)
+    , m_firstPaint(-1)
+    , m_complete(-1)
+    , m_loaded(false)
+{
+    m_path = QDir::temp().absoluteFilePath(QString("dfm-populatebench-%1").arg(QString::number(entries)));
+}
+
+PopulateBench::~PopulateBench()
+{
+    delete m_model;
+    removeEntries();
+}
+
+void
+PopulateBench::createEntries()
+{
+    removeEntries();
+    QDir().mkpath(m_path);
+    const QDir dir(m_path);
+    for (int i = 0; i < m_entries; ++i)
+    {
+        //mix in some directories so the dirs first sorting has some work to do...
+        const QString &name = QString("entry%1").arg(i, 7, 10, QChar('0'));
+        if (!(i % 100))
+        {
+            dir.mkdir(name);
+            continue;
+        }
+        QFile file(dir.absoluteFilePath(name));
+        file.open(QFile::WriteOnly);
+        file.close();
+    }
+}
+
+void
+PopulateBench::removeEntries()
+{
+    QDir dir(m_path);
+    if (!dir.exists())
+        return;
+    const QStringList &entries = dir.entryList(allEntries);
+    for (int i = 0; i < entries.count(); ++i)
+        if (!dir.remove(entries.at(i)))
+            dir.rmdir(entries.at(i));
+    QDir().rmdir(m_path);
+}
+
+void
+PopulateBench::run()
+{
+    createEntries();
+    m_model = new FS::Model();
+    connect(m_model, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(rowsInserted(QModelIndex,int,int)));
+    connect(m_model, SIGNAL(urlLoaded(QUrl)), this, SLOT(urlLoaded(QUrl)));
+
+    QEventLoop loop;
+    QTimer poll;
+    connect(&poll, SIGNAL(timeout()), this, SLOT(checkFinished()));
+    poll.start(5);
+
+    m_timer.start();
+    m_model->setUrl(QUrl::fromLocalFile(m_path));
+    while (m_complete == -1)
+        loop.processEvents(QEventLoop::WaitForMoreEvents);
+}
+
+void
+PopulateBench::rowsInserted(const QModelIndex &parent, int start, int end)
+{
+    Q_UNUSED(start);
+    Q_UNUSED(end);
+    if (m_firstPaint == -1 && parent.data(FS::FilePathRole).toString() == m_path)
+        m_firstPaint = m_timer.elapsed();
+}
+
+void
+PopulateBench::urlLoaded(const QUrl &url)
+{
+    if (url.toLocalFile() == m_path)
+        m_loaded = true;
+}
+
+void
+PopulateBench::checkFinished()
+{
+    if (m_loaded && m_complete == -1 && !m_model->isWorking())
+        m_complete = m_timer.elapsed();
+}
+
+int main(int argc, char *argv[])
+{
+    Application app(argc, argv);
+
+    QList<int> sizes;
+    for (int i = 1; i < app.arguments().count(); ++i)
+        if (const int size = app.arguments().at(i).toInt())
+            sizes << size;
+    if (sizes.isEmpty())
+        sizes << 10000 << 100000 << 1000000;
+
+    QTextStream out(stdout);
+    out << "entries\tfirst paint (ms)\tcomplete (ms)\n";
+    for (int i = 0; i < sizes.count(); ++i)
+    {
+        PopulateBench bench(sizes.at(i));
+        bench.run();
+        out << sizes.at(i) << "\t" << bench.firstPaint() << "\t" << bench.complete() << "\n";
+        out.flush();
+    }
+    return 0;
+}
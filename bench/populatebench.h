@@ -0,0 +1,70 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+
+#ifndef POPULATEBENCH_H
+#define POPULATEBENCH_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QModelIndex>
+#include <QUrl>
+
+namespace DFM
+{
+namespace FS { class Model; }
+
+/* Lists a directory with a given number of
+ * synthetic entries through FS::Model and
+ * records when the first rows reach the model
+ * and when the directory is completely loaded.
+ */
+
+class PopulateBench : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PopulateBench(const int entries, QObject *parent = 0);
+    ~PopulateBench();
+    void run();
+    inline qint64 firstPaint() const { return m_firstPaint; }
+    inline qint64 complete() const { return m_complete; }
+
+protected:
+    void createEntries();
+    void removeEntries();
+
+private slots:
+    void rowsInserted(const QModelIndex &parent, int start, int end);
+    void urlLoaded(const QUrl &url);
+    void checkFinished();
+
+private:
+    int m_entries;
+    QString m_path;
+    FS::Model *m_model;
+    QElapsedTimer m_timer;
+    qint64 m_firstPaint, m_complete;
+    bool m_loaded;
+};
+
+}
+
+#endif // POPULATEBENCH_H
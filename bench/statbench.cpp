@@ -0,0 +1,86 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+#include <QDir>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QCoreApplication>
+
+#include "statbench.h"
+#include "statbatch.h"
+#include "globals.h"
+
+#include <sys/stat.h>
+
+using namespace DFM;
+
+StatBench::StatBench(const QString &path)
+    : m_path(path)
+    , m_plain(-1)
+    , m_batched(-1)
+{
+    const QDir dir(m_path);
+    const QStringList &names = dir.entryList(allEntries);
+    for (int i = 0; i < names.count(); ++i)
+        m_files << dir.absoluteFilePath(names.at(i));
+}
+
+void
+StatBench::run()
+{
+    //batched goes first, whatever it warms only helps the plain run
+    QElapsedTimer timer;
+    timer.start();
+    StatBatch::Results results;
+    StatBatch::stat(m_files, results);
+    m_batched = timer.elapsed();
+
+    timer.start();
+    for (int i = 0; i < m_files.count(); ++i)
+    {
+        struct stat st;
+        ::stat(QFile::encodeName(m_files.at(i)).constData(), &st);
+    }
+    m_plain = timer.elapsed();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QStringList paths;
+    for (int i = 1; i < app.arguments().count(); ++i)
+        paths << app.arguments().at(i);
+    if (paths.isEmpty())
+        paths << QDir::currentPath();
+
+    QTextStream out(stdout);
+    out << "io_uring: " << (StatBatch::hasUring() ? "yes" : "no") << "\n";
+    out << "path\tentries\tplain (ms)\tbatched (ms)\n";
+    for (int i = 0; i < paths.count(); ++i)
+    {
+        StatBench bench(paths.at(i));
+        bench.run();
+        out << paths.at(i) << "\t" << bench.entries() << "\t" << bench.plain() << "\t" << bench.batched() << "\n";
+        out.flush();
+    }
+    return 0;
+}
@@ -0,0 +1,54 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+
+#ifndef STATBENCH_H
+#define STATBENCH_H
+
+#include <QStringList>
+
+namespace DFM
+{
+
+/* Stats every entry of a directory once through
+ * StatBatch and once one file at a time. Give it
+ * a directory on a network filesystem or a cold
+ * disk, on a warm local cache both are just
+ * memory lookups.
+ */
+
+class StatBench
+{
+public:
+    explicit StatBench(const QString &path);
+    void run();
+    inline int entries() const { return m_files.count(); }
+    inline qint64 plain() const { return m_plain; }
+    inline qint64 batched() const { return m_batched; }
+
+private:
+    QString m_path;
+    QStringList m_files;
+    qint64 m_plain, m_batched;
+};
+
+}
+
+#endif // STATBENCH_H
@@ -402,9 +402,17 @@ Column::Column(QWidget *parent)
     connect(m_sizeTimer, SIGNAL(timeout()), this, SLOT(saveWidth()));
 }
 
+void
+Column::hideEvent(QHideEvent *e)
+{
+    QListView::hideEvent(e);
+    clearViewport();
+}
+
 void
 Column::paintEvent(QPaintEvent *e)
 {
+    reportViewport(this);
     QPainter p(viewport());
     for (int i = 0; i < model()->rowCount(rootIndex()); ++i)
     {
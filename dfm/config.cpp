@@ -73,11 +73,19 @@ Store::readConfiguration()
     config.behaviour.sideBarStyle = settings()->value("sideBarStyle", 1).toInt();
     config.behaviour.pathBarPlace = settings()->value("behaviour.pathBarPlace", 0).toInt();
     config.behaviour.useIOQueue = settings()->value("behaviour.useIOQueue", true).toBool();
+    config.behaviour.copyQueueDepth = settings()->value("behaviour.copyQueueDepth", 8).toInt();
+    config.behaviour.nodeCacheSize = settings()->value("behaviour.nodeCacheSize", 500).toInt();
+    config.behaviour.dormantTimeout = settings()->value("behaviour.dormantTimeout", 10).toInt();
     config.behaviour.showCloseTabButton = settings()->value("behaviour.showCloseTabButton", false).toBool();
+    config.behaviour.searchOtherFs = settings()->value("behaviour.searchOtherFs", false).toBool();
+    config.behaviour.lazyStat = settings()->value("behaviour.lazyStat", true).toBool();
+    config.behaviour.searchExcludes = settings()->value("behaviour.searchExcludes", QStringList() << ".git" << ".svn" << ".hg").toStringList();
 
     config.views.showThumbs = settings()->value("showThumbs", false).toBool();
     config.views.activeThumbIfaces = settings()->value("activeThumbIfaces", QStringList()).toStringList();
+    config.views.thumbCacheSize = settings()->value("views.thumbCacheSize", 512).toInt();
     config.views.singleClick = settings()->value("views.singleClick", false).toBool();
+    config.views.naturalSort = settings()->value("views.naturalSort", false).toBool();
     config.views.flowSize = settings()->value("flowSize", QByteArray()).toByteArray();
 
     //IconView
@@ -157,7 +165,13 @@ Store::writeConfiguration()
 
     settings()->setValue("behaviour.pathBarPlace", config.behaviour.pathBarPlace);
     settings()->setValue("behaviour.useIOQueue", config.behaviour.useIOQueue);
+    settings()->setValue("behaviour.copyQueueDepth", config.behaviour.copyQueueDepth);
+    settings()->setValue("behaviour.nodeCacheSize", config.behaviour.nodeCacheSize);
+    settings()->setValue("behaviour.dormantTimeout", config.behaviour.dormantTimeout);
     settings()->setValue("behaviour.showCloseTabButton", config.behaviour.showCloseTabButton);
+    settings()->setValue("behaviour.searchOtherFs", config.behaviour.searchOtherFs);
+    settings()->setValue("behaviour.lazyStat", config.behaviour.lazyStat);
+    settings()->setValue("behaviour.searchExcludes", config.behaviour.searchExcludes);
 
     settings()->setValue("detailsView.rowPadding", config.views.detailsView.rowPadding);
     settings()->setValue("detailsView.altRows", config.views.detailsView.altRows);
@@ -178,6 +192,7 @@ Store::writeConfiguration()
         settings()->setValue("hideTabBarWhenOnlyOne", config.behaviour.hideTabBarWhenOnlyOneTab);
     settings()->setValue("styleSheet", config.styleSheet);
     settings()->setValue("views.singleClick", config.views.singleClick);
+    settings()->setValue("views.naturalSort", config.views.naturalSort);
 
     settings()->setValue("useSystemIcons", config.behaviour.systemIcons);
     settings()->setValue("behaviour.invActBookmark", config.behaviour.invActBookmark);
@@ -186,6 +201,7 @@ Store::writeConfiguration()
     settings()->setValue("pluginPath", config.pluginPath);
 
     settings()->setValue("activeThumbIfaces", config.views.activeThumbIfaces);
+    settings()->setValue("views.thumbCacheSize", config.views.thumbCacheSize);
 
     settings()->setValue("columnsView.colWidth", config.views.columnsView.colWidth);
 
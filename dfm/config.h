@@ -49,7 +49,9 @@ typedef struct Config
         invActBookmark,
         invAllBookmarks,
         useIOQueue,
-        showCloseTabButton;
+        showCloseTabButton,
+        searchOtherFs,
+        lazyStat;
 
         int tabShape,
         tabRoundness,
@@ -61,16 +63,21 @@ typedef struct Config
         sideBarStyle,
         view,
         minFontSize,
-        pathBarPlace;
+        pathBarPlace,
+        copyQueueDepth,
+        nodeCacheSize,
+        dormantTimeout;
 
+        QStringList searchExcludes;
         Qt::SortOrder sortingOrd;
     } behaviour;
 
     struct views
     {
         QByteArray flowSize;
-        bool showThumbs, singleClick, dirSettings;
+        bool showThumbs, singleClick, dirSettings, naturalSort;
         QStringList activeThumbIfaces;
+        int thumbCacheSize;
         struct iconView
         {
             bool categorized;
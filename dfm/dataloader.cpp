@@ -25,25 +25,50 @@
 #include "config.h"
 #include "application.h"
 #include "interfaces.h"
+#include "thumbcache.h"
 #include <QMutexLocker>
 #include <QImageReader>
 #include <QWaitCondition>
 #include <QDateTime>
+#include <QThreadStorage>
 #include <QDebug>
 
 using namespace DFM;
 
 DDataLoader *DDataLoader::s_instance = 0;
 DHash<QString, Data *> DDataLoader::s_data;
-DQueue<QString> DDataLoader::s_queue;
-DMimeProvider DDataLoader::s_mimeProvider;
+DPriorityQueue<QString> DDataLoader::s_queue;
+QSet<QString> DDataLoader::s_busy;
+QMutex DDataLoader::s_busyMutex;
+QHash<const void *, QPair<QStringList, QStringList> > DDataLoader::s_viewports;
+QHash<QString, int> DDataLoader::s_priority;
+QMutex DDataLoader::s_viewportMutex;
+
+class DDataLoader::Worker : public QRunnable
+{
+public:
+    Worker(DDataLoader *loader) : m_loader(loader) {}
+    void run()
+    {
+        QString path;
+        while (s_queue.dequeue(path))
+            m_loader->getData(path);
+        m_loader->workerDone();
+    }
+private:
+    DDataLoader *m_loader;
+};
 
 DDataLoader::DDataLoader(QObject *parent) :
     QThread(parent),
-    m_extent(256)
+    m_extent(256),
+    m_workers(0),
+    m_pool(new QThreadPool(this))
 {
+    m_pool->setMaxThreadCount(QThread::idealThreadCount());
     connect(this, SIGNAL(started()), this, SLOT(init()));
     connect(this, SIGNAL(dataRequested()), this, SLOT(loadData()), Qt::QueuedConnection);
+    connect(this, SIGNAL(serialRequested()), this, SLOT(loadSerial()), Qt::QueuedConnection);
     moveToThread(this);
     start();
 }
@@ -52,8 +77,27 @@ void
 DDataLoader::init()
 {
     dApp->loadPlugins();
+    ThumbCache::instance(); //before the pool threads race to create it
     foreach (ThumbInterface *ti, dApp->thumbIfaces())
+    {
         ti->init();
+        if (ti->isThreadSafe())
+        {
+            const int max = ti->maxConcurrency();
+            m_slots.insert(ti, new QSemaphore(max > 0 ? max : QThread::idealThreadCount()));
+        }
+    }
+}
+
+DMimeProvider
+*DDataLoader::mimeProvider()
+{
+    //libmagic cookies cant be shared between threads,
+    //so every thread in the pool gets its own.
+    static QThreadStorage<DMimeProvider *> s_providers;
+    if (!s_providers.hasLocalData())
+        s_providers.setLocalData(new DMimeProvider());
+    return s_providers.localData();
 }
 
 DDataLoader
@@ -79,34 +123,144 @@ DDataLoader::removeData(const QString &file)
     s_data.destroy(file);
 }
 
+QString
+Data::entries() const
+{
+    if (count > 1)
+        return QString("%1 Entries").arg(count);
+    if (count == 1)
+        return QString("1 Entry");
+    if (!count)
+        return QString("Empty");
+    return QString();
+}
+
+//without a stamp whatever is cached is trusted, changes
+//on disk reach the cache through the nodes the watcher updates
 Data
 *DDataLoader::data(const QString &file, const bool checkOnly)
+{
+    return data(file, FileStamp(), checkOnly);
+}
+
+Data
+*DDataLoader::data(const QString &file, const FileStamp &stamp, const bool checkOnly)
 {
     if (Data *data = s_data.value(file, 0))
     {
-        const bool isChecked = data->lastModified == QFileInfo(file).lastModified().toString();
-        if (isChecked)
+        //any difference means the file changed, the same mtime with
+        //another size or inode too. a node that wasnt stat'ed again
+        //takes the stamp of the data once it comes in, see Model::newData()
+        if (stamp.isNull() || stamp == data->stamp)
             return data;
 
         s_data.destroy(file);
     }
     if (checkOnly)
         return 0;
-    if (s_queue.enqueue(file))
+    s_busyMutex.lock();
+    const bool busy = s_busy.contains(file);
+    s_busyMutex.unlock();
+    if (busy)
+        return 0;
+    s_viewportMutex.lock();
+    const int priority = s_priority.value(file, Background);
+    s_viewportMutex.unlock();
+    if (s_queue.enqueue(file, priority))
         emit instance()->dataRequested();
     return 0;
 }
 
+void
+DDataLoader::setVisible(const void *view, const QStringList &visible, const QStringList &near)
+{
+    QMutexLocker locker(&s_viewportMutex);
+    if (visible.isEmpty() && near.isEmpty())
+        s_viewports.remove(view);
+    else
+        s_viewports.insert(view, qMakePair(visible, near));
+
+    //rebuild from all views, there are only ever
+    //a few hundred files on screen so this is cheap.
+    const QHash<QString, int> old = s_priority;
+    s_priority.clear();
+    QHash<const void *, QPair<QStringList, QStringList> >::const_iterator it = s_viewports.constBegin(), end = s_viewports.constEnd();
+    for (; it != end; ++it)
+    {
+        for (int i = 0; i < it.value().second.count(); ++i)
+            if (!s_priority.contains(it.value().second.at(i)))
+                s_priority.insert(it.value().second.at(i), Near);
+        for (int i = 0; i < it.value().first.count(); ++i)
+            s_priority.insert(it.value().first.at(i), Visible);
+    }
+    s_priority.remove(QString());
+
+    //whatever left the screen goes to the back of the queue...
+    for (QHash<QString, int>::const_iterator i = old.constBegin(); i != old.constEnd(); ++i)
+        if (!s_priority.contains(i.key()))
+            s_queue.setLevel(i.key(), Background);
+
+    //...and what is on or near it to the front. Visible files get
+    //requested anyway when painted, the ones near we fetch ahead.
+    bool queued = false;
+    for (QHash<QString, int>::const_iterator i = s_priority.constBegin(); i != s_priority.constEnd(); ++i)
+    {
+        if (s_queue.setLevel(i.key(), i.value()) || i.value() != Near || s_data.contains(i.key()))
+            continue;
+        s_busyMutex.lock();
+        const bool busy = s_busy.contains(i.key());
+        s_busyMutex.unlock();
+        if (!busy)
+            queued |= s_queue.enqueue(i.key(), Near);
+    }
+    locker.unlock();
+    if (queued)
+        emit instance()->dataRequested();
+}
+
+void
+DDataLoader::loadData()
+{
+    //workers drain the queue themselves, so we only
+    //need to wake up as many as there is work for.
+    QMutexLocker locker(&m_mutex);
+    const int queued = s_queue.count();
+    while (m_workers < m_pool->maxThreadCount() && m_workers < queued)
+    {
+        ++m_workers;
+        m_pool->start(new Worker(this));
+    }
+}
+
+void
+DDataLoader::workerDone()
+{
+    m_mutex.lock();
+    --m_workers;
+    m_mutex.unlock();
+    //something might have been queued after we
+    //found the queue empty but before we left.
+    if (!s_queue.isEmpty())
+        emit dataRequested();
+}
+
 void
 DDataLoader::getData(const QString &path)
 {
+    s_busyMutex.lock();
+    s_busy.insert(path);
+    s_busyMutex.unlock();
     const QFileInfo fi(path);
     if (!fi.isReadable() || !fi.exists())
     {
         removeData(path);
+        s_busyMutex.lock();
+        s_busy.remove(path);
+        s_busyMutex.unlock();
         return;
     }
     Data *data = new Data();
+    data->stamp = FileStamp::fromFile(path);
     if (fi.isDir())
     {
         const QString &dirFile(fi.absoluteFilePath());
@@ -118,47 +272,98 @@ DDataLoader::getData(const QString &path)
         if (!iconName.isEmpty())
             data->iconName = iconName;
 #endif
-        QString count;
-        int c = dir.entryList(allEntries).count();
-        const QString &children = QString::number(c);
-        if (c > 1)
-            count = QString("%1%2").arg(children, " Entries");
-        else if (c == 1)
-            count = QString("%1%2").arg(children, " Entry");
-        else
-            count = QString("Empty");
-        data->count = count;
-        data->mimeType = s_mimeProvider.getMimeType(path);
-        data->fileType = s_mimeProvider.getFileType(path);
-        data->lastModified = fi.lastModified().toString();
-        s_data.insert(path, data);
-        emit newData(path);
+        data->count = dir.entryList(allEntries).count();
+        data->mimeType = mimeProvider()->getMimeType(path);
+        data->fileType = mimeProvider()->getFileType(path);
+        finish(path, data);
         return;
     }
-    QImage image;
-    const QString mime(s_mimeProvider.getMimeType(path));
+    const QString mime(mimeProvider()->getMimeType(path));
+    data->mimeType = mime;
+    QString iconName = mime;
+    iconName.replace("/", "-");
+    data->iconName = iconName;
+    data->fileType = mimeProvider()->getFileType(path);
 
     if (!dApp->activeThumbIfaces().isEmpty() && Store::config.views.showThumbs)
-    for (int i = 0; i<dApp->activeThumbIfaces().count(); ++i)
-    if (dApp->activeThumbIfaces().at(i)->thumb(path, mime, image, m_extent))
     {
-        data->thumb = image;
-        break;
+        QImage image;
+        const uint mtime = data->stamp.secs();
+        if (ThumbCache::thumb(path, mtime, m_extent, image))
+            data->thumb = image;
+        else if (!getThumb(path, data, mtime))
+            return; //handed over to the loader thread
     }
+    finish(path, data);
+}
 
-    data->mimeType = mime;
-    QString iconName = mime;
-    iconName.replace("/", "-");
-    data->iconName = iconName;
-    data->lastModified = fi.lastModified().toString();
-    data->fileType = s_mimeProvider.getFileType(path);
-    s_data.insert(path, data);
-    emit newData(path);
+bool
+DDataLoader::getThumb(const QString &path, Data *data, const uint mtime, const int start)
+{
+    const bool serial = QThread::currentThread() == this;
+    const QList<ThumbInterface *> plugins = dApp->activeThumbIfaces();
+    for (int i = start; i < plugins.count(); ++i)
+    {
+        ThumbInterface *ti = plugins.at(i);
+        QImage image;
+        bool ok;
+        if (QSemaphore *sem = m_slots.value(ti, 0))
+        {
+            sem->acquire();
+            ok = ti->thumb(path, data->mimeType, image, m_extent);
+            sem->release();
+        }
+        else if (!serial)
+        {
+            //plugins that arent threadsafe are only called from the
+            //thread they were initialized in, one file at a time.
+            SerialJob job;
+            job.path = path;
+            job.data = data;
+            job.mtime = mtime;
+            job.plugin = i;
+            m_mutex.lock();
+            m_serialQueue.enqueue(job);
+            m_mutex.unlock();
+            emit serialRequested();
+            return false;
+        }
+        else
+            ok = ti->thumb(path, data->mimeType, image, m_extent);
+        if (ok)
+        {
+            data->thumb = image;
+            ThumbCache::store(path, mtime, m_extent, image);
+            break;
+        }
+    }
+    return true;
 }
 
 void
-DDataLoader::loadData()
+DDataLoader::loadSerial()
 {
-    while (!s_queue.isEmpty())
-        getData(s_queue.dequeue());
+    forever
+    {
+        m_mutex.lock();
+        if (m_serialQueue.isEmpty())
+        {
+            m_mutex.unlock();
+            return;
+        }
+        const SerialJob job = m_serialQueue.dequeue();
+        m_mutex.unlock();
+        getThumb(job.path, job.data, job.mtime, job.plugin);
+        finish(job.path, job.data);
+    }
+}
+
+void
+DDataLoader::finish(const QString &path, Data *data)
+{
+    s_data.insert(path, data);
+    s_busyMutex.lock();
+    s_busy.remove(path);
+    s_busyMutex.unlock();
+    emit newData(path);
 }
@@ -24,13 +24,22 @@
 
 #include "objects.h"
 #include "helpers.h"
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QSet>
+#include <QStringList>
+
+class ThumbInterface;
 
 class Data
 {
 public:
+    Data() : count(-1) {}
+    QString entries() const; //count as shown, formatted when asked
     QImage thumb;
-    QString count; //entries for dirs...
-    QString mimeType, iconName, lastModified, fileType;
+    int count; //entries for dirs...
+    DFM::FileStamp stamp; //of the file when this was loaded
+    QString mimeType, iconName, fileType;
 };
 
 namespace DFM
@@ -40,10 +49,13 @@ class DDataLoader : public QThread
 {
     Q_OBJECT
 public:
+    enum Priority { Visible = 0, Near, Background };
     static DDataLoader *instance();
     static inline void clearQueue() { s_queue.clear(); }
     static void removeData(const QString &file);
     static Data *data(const QString &file, const bool checkOnly = false);
+    static Data *data(const QString &file, const FileStamp &stamp, const bool checkOnly = false);
+    static void setVisible(const void *view, const QStringList &visible, const QStringList &near = QStringList());
 
 public slots:
 //    void discontinue() { s_queue.clear(); DThread::discontinue(); }
@@ -53,21 +65,44 @@ signals:
     void newData(const QString &file);
     void noLongerExists(const QString &file);
     void dataRequested();
+    void serialRequested();
 
 protected:
     explicit DDataLoader(QObject *parent = 0);
     void getData(const QString &path);
+    bool getThumb(const QString &path, Data *data, const uint mtime, const int start = 0);
+    void finish(const QString &path, Data *data);
+    void workerDone();
+    static DMimeProvider *mimeProvider();
 
 protected slots:
     void loadData();
+    void loadSerial();
     void init();
 
 private:
-    int m_extent;
+    class Worker;
+    friend class Worker;
+    struct SerialJob
+    {
+        QString path;
+        Data *data;
+        uint mtime;
+        int plugin;
+    };
+    int m_extent, m_workers;
+    QThreadPool *m_pool;
+    QMutex m_mutex;
+    QQueue<SerialJob> m_serialQueue;
+    QHash<ThumbInterface *, QSemaphore *> m_slots;
 
     static DHash<QString, Data *> s_data;
-    static DQueue<QString> s_queue;
-    static DMimeProvider s_mimeProvider;
+    static DPriorityQueue<QString> s_queue;
+    static QSet<QString> s_busy;
+    static QMutex s_busyMutex;
+    static QHash<const void *, QPair<QStringList, QStringList> > s_viewports;
+    static QHash<QString, int> s_priority;
+    static QMutex s_viewportMutex;
     static DDataLoader *s_instance;
 };
 
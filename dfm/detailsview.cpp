@@ -247,6 +247,35 @@ DetailsView::resizeEvent(QResizeEvent *event)
 //        setColumnWidth(i, w*0.1f);
 }
 
+void
+DetailsView::paintEvent(QPaintEvent *event)
+{
+    reportViewport(this);
+    QTreeView::paintEvent(event);
+}
+
+void
+DetailsView::hideEvent(QHideEvent *event)
+{
+    QTreeView::hideEvent(event);
+    clearViewport();
+}
+
+QModelIndexList
+DetailsView::visibleIndexes(QAbstractItemView *view) const
+{
+    Q_UNUSED(view);
+    //walk the rows as shown, that way expanded children are included
+    QModelIndexList visible;
+    QModelIndex index = indexAt(QPoint(0, 0));
+    while (index.isValid() && visualRect(index).top() <= viewport()->height())
+    {
+        visible << index.sibling(index.row(), 0);
+        index = indexBelow(index);
+    }
+    return visible;
+}
+
 bool
 DetailsView::edit(const QModelIndex &index, EditTrigger trigger, QEvent *event)
 {
@@ -48,8 +48,11 @@ protected:
     void mouseDoubleClickEvent(QMouseEvent *event);
     void keyPressEvent(QKeyEvent *);
     void resizeEvent(QResizeEvent *event);
+    void paintEvent(QPaintEvent *event);
+    void hideEvent(QHideEvent *event);
     void wheelEvent(QWheelEvent *e);
     bool edit(const QModelIndex &index, EditTrigger trigger, QEvent *event);
+    QModelIndexList visibleIndexes(QAbstractItemView *view) const;
 
 signals:
     void newTabRequest(const QModelIndex &path);
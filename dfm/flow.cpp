@@ -290,6 +290,7 @@ Flow::Flow(QWidget *parent)
 
 Flow::~Flow()
 {
+    DDataLoader::setVisible(this, QStringList());
     m_dataLoader->discontinue();
     m_dataLoader->wait();
     qDeleteAll(m_items);
@@ -482,6 +483,33 @@ Flow::setCenterIndex(const QModelIndex &index)
     m_textItem->setZValue(m_items.count()+2);
     m_gfxProxy->setZValue(m_items.count()+2);
     m_textItem->setPos(m_x-m_textItem->boundingRect().width()/2.0f, rect().bottom()-(bMargin+m_scrollBar->height()+m_textItem->boundingRect().height()));
+    reportViewport();
+}
+
+void
+Flow::reportViewport()
+{
+    if (!m_model || !isVisible() || m_row < 0)
+        return;
+    //the side items are stacked 'space' apart
+    const int side = qCeil(width()/(2.0f*space))+1;
+    const int rows = m_model->rowCount(m_rootIndex);
+    QStringList visible, near;
+    QModelIndexList shown;
+    for (int i = qMax(0, m_row-side*2); i < qMin(rows, m_row+side*2+1); ++i)
+    {
+        const QModelIndex &index = m_model->index(i, 0, m_rootIndex);
+        const QString &file = index.data(FS::FilePathRole).toString();
+        if (qAbs(i-m_row) <= side)
+        {
+            visible << file;
+            shown << index;
+        }
+        else
+            near << file;
+    }
+    m_model->statRows(shown);
+    DDataLoader::setVisible(this, visible, near);
 }
 
 void
@@ -508,6 +536,14 @@ Flow::showEvent(QShowEvent *event)
 {
     QGraphicsView::showEvent(event);
     updateScene();
+    reportViewport();
+}
+
+void
+Flow::hideEvent(QHideEvent *event)
+{
+    QGraphicsView::hideEvent(event);
+    DDataLoader::setVisible(this, QStringList());
 }
 
 void
@@ -138,6 +138,7 @@ public slots:
 protected:
     void resizeEvent(QResizeEvent *event);
     void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
     void wheelEvent(QWheelEvent *event);
     void mousePressEvent(QMouseEvent *event);
     void mouseReleaseEvent(QMouseEvent *event);
@@ -150,6 +151,7 @@ protected:
     void showPrevious();
     void showNext();
     inline int validate(const int row) { return qBound(0, row, m_items.count()-1); }
+    void reportViewport();
 
     template<typename T>T itemAtAs(const QPoint &pos){return dynamic_cast<T>(itemAt(pos));}
 
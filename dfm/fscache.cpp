@@ -0,0 +1,127 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+
+#include "fscache.h"
+#include "fswatcher.h"
+
+using namespace DFM;
+using namespace FS;
+
+DirCache *DirCache::s_instance = 0;
+
+DirCache
+*DirCache::instance()
+{
+    //first call comes from the model ctor, so we live in the gui thread
+    if (!s_instance)
+        s_instance = new DirCache();
+    return s_instance;
+}
+
+DirCache::DirCache(QObject *parent) : QObject(parent)
+{
+    WatchHub *hub = WatchHub::instance();
+    connect(hub, SIGNAL(directoryChanged(QString)), this, SLOT(invalidate(QString)));
+    connect(hub, SIGNAL(watchLost(QString)), this, SLOT(unwatched(QString)));
+    connect(hub, SIGNAL(watchAdded(QString)), this, SLOT(watched(QString)));
+    connect(hub, SIGNAL(watchRemoved(QString)), this, SLOT(unwatched(QString)));
+    connect(hub, SIGNAL(entriesChanged(QString,QStringList,QStringList,QStringList)), this, SLOT(entriesChanged(QString,QStringList,QStringList,QStringList)));
+}
+
+bool
+DirCache::acquire(const QString &dir, Entries &entries)
+{
+    QMutexLocker locker(&m_mutex);
+    QHash<QString, Listing>::iterator it = m_listings.find(dir);
+    if (it == m_listings.end() || !it.value().valid || !m_watched.contains(dir))
+        return false;
+    //cheap check for entries added or removed behind the watchers back
+    if (FileStamp::fromFile(dir) != it.value().stamp)
+    {
+        it.value().valid = false;
+        return false;
+    }
+    ++it.value().refs;
+    entries = it.value().entries;
+    return true;
+}
+
+void
+DirCache::store(const QString &dir, const Entries &entries, const FileStamp &dirStamp, const bool addRef)
+{
+    QMutexLocker locker(&m_mutex);
+    Listing &l = m_listings[dir];
+    l.stamp = dirStamp;
+    l.valid = !dirStamp.isNull() && m_watched.contains(dir);
+    l.entries = l.valid ? entries : Entries(); //nobody else could trust them
+    if (addRef)
+        ++l.refs;
+    if (!l.refs)
+        m_listings.remove(dir);
+}
+
+void
+DirCache::release(const QString &dir)
+{
+    QMutexLocker locker(&m_mutex);
+    QHash<QString, Listing>::iterator it = m_listings.find(dir);
+    if (it != m_listings.end() && --it.value().refs <= 0)
+        m_listings.erase(it);
+}
+
+void
+DirCache::invalidate(const QString &dir)
+{
+    //the holders keep their refs, the next store makes it valid again
+    QMutexLocker locker(&m_mutex);
+    QHash<QString, Listing>::iterator it = m_listings.find(dir);
+    if (it != m_listings.end())
+    {
+        it.value().valid = false;
+        it.value().entries.clear();
+    }
+}
+
+void
+DirCache::watched(const QString &dir)
+{
+    QMutexLocker locker(&m_mutex);
+    m_watched.insert(dir);
+}
+
+//what was listed before is not known to be current anymore
+void
+DirCache::unwatched(const QString &dir)
+{
+    m_mutex.lock();
+    m_watched.remove(dir);
+    m_mutex.unlock();
+    invalidate(dir);
+}
+
+void
+DirCache::entriesChanged(const QString &dir, const QStringList &added, const QStringList &removed, const QStringList &changed)
+{
+    Q_UNUSED(added);
+    Q_UNUSED(removed);
+    Q_UNUSED(changed);
+    invalidate(dir);
+}
@@ -0,0 +1,99 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+
+#ifndef FSCACHE_H
+#define FSCACHE_H
+
+#include <QObject>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+
+#include "helpers.h"
+
+namespace DFM
+{
+namespace FS
+{
+
+/* Directory listings shared between all models of the
+ * process. The first model populating a directory lists
+ * and stats it, every other tab or window showing the same
+ * directory takes the entries from here as long as someone
+ * still holds the listing and the directory did not change.
+ * Only watched directories are shared, a change in one
+ * nobody watches would go unnoticed until its mtime moved.
+ * An entry carries what the nodes keep of a stat, so a
+ * file is only stat'ed once per process.
+ */
+
+class DirCache : public QObject
+{
+    Q_OBJECT
+public:
+    struct Entry
+    {
+        QString path;
+        FileStamp stamp; //null when the entry was never stat'ed
+        uint perms; //Node::SortKey perms
+        uchar flags; //Node::SortKey flags
+    };
+    typedef QList<Entry> Entries;
+
+    static DirCache *instance();
+
+    bool acquire(const QString &dir, Entries &entries);
+    void store(const QString &dir, const Entries &entries, const FileStamp &dirStamp, const bool addRef);
+    void release(const QString &dir);
+
+public slots:
+    void invalidate(const QString &dir);
+
+private slots:
+    void watched(const QString &dir);
+    void unwatched(const QString &dir);
+    void entriesChanged(const QString &dir, const QStringList &added, const QStringList &removed, const QStringList &changed);
+
+protected:
+    explicit DirCache(QObject *parent = 0);
+
+private:
+    struct Listing
+    {
+        Listing() : refs(0), valid(false) {}
+        Entries entries;
+        FileStamp stamp;
+        int refs;
+        bool valid;
+    };
+    static DirCache *s_instance;
+    QHash<QString, Listing> m_listings;
+    QSet<QString> m_watched; //mirrors the watch hub for the runners
+    QMutex m_mutex;
+};
+
+}
+
+}
+
+#endif // FSCACHE_H
@@ -21,11 +21,11 @@
 #include <QImageReader>
 #include <QDirIterator>
 #include <QDesktopServices>
-#include <QFileSystemWatcher>
 #include <QMessageBox>
 #include <QPainter>
 #include <QAbstractItemView>
 #include <QDir>
+#include <QFile>
 #include <QTimer>
 #include <QMimeData>
 #include <QSettings>
@@ -37,6 +37,7 @@
 #include <QWaitCondition>
 #include <QMenu>
 #include <QApplication>
+#include <QThread>
 #if !defined(QT_NO_DBUS)
 #include <QDBusMessage>
 #include <QDBusConnection>
@@ -48,6 +49,8 @@
 #include "mainwindow.h"
 #include "dataloader.h"
 #include "fsworkers.h"
+#include "fswatcher.h"
+#include "fscache.h"
 #include "helpers.h"
 #include "config.h"
 
@@ -56,6 +59,50 @@ using namespace FS;
 
 static FileIconProvider *s_instance = 0;
 
+//every model of the process, they all live in the gui thread. each
+//tab has a tree of its own but the node budget is for all of them.
+static QList<Model *> s_models;
+static qint64 s_tick = 0;
+
+static int
+totalNodeCount()
+{
+    int count = 0;
+    for (int i = 0; i < s_models.count(); ++i)
+        count += s_models.at(i)->nodeCount();
+    return count;
+}
+
+#define RESOLVETIMEOUT 5000 //ms before a mount counts as stalled
+#define STALLRETRY 30000 //ms a stalled mount is left alone
+#define PREFETCHHISTORY 2 //forward history entries worth guessing
+#define CHANGEBATCH 16 //ms new data is gathered before the views hear of it, about a frame
+
+//longest mount point holding path, /proc is answered
+//by the kernel so this never waits on the mount itself
+static QString
+mountPoint(const QString &path)
+{
+    QString mount("/");
+#if defined(ISUNIX)
+    QFile mounts("/proc/self/mounts");
+    if (!mounts.open(QFile::ReadOnly))
+        return mount;
+    const QList<QByteArray> &lines = mounts.readAll().split('\n');
+    for (int i = 0; i < lines.count(); ++i)
+    {
+        const QList<QByteArray> &fields = lines.at(i).split(' ');
+        if (fields.count() < 2)
+            continue;
+        QString point = QFile::decodeName(fields.at(1));
+        point.replace("\\040", " ");
+        if (point.length() > mount.length() && (path == point || path.startsWith(point + "/")))
+            mount = point;
+    }
+#endif
+    return mount;
+}
+
 FileIconProvider
 *FileIconProvider::instance()
 {
@@ -103,17 +150,47 @@ Model::Model(QObject *parent)
     , m_showHidden(false)
     , m_sortOrder(Qt::AscendingOrder)
     , m_sortColumn(0)
-    , m_watcher(new QFileSystemWatcher(this))
+    , m_watcher(new Watcher(this))
     , m_dataGatherer(new Worker::Gatherer(this))
     , m_lockHistory(false)
     , m_schemeMenu(new QMenu())
     , m_current(0)
     , m_currentRoot(0)
     , m_timer(new QTimer(this))
-{
+    , m_catNode(0)
+    , m_catValid(false)
+    , m_catPending(false)
+    , m_nodeCount(0)
+    , m_refs(1)
+    , m_placeholder(0)
+    , m_resolveTimer(new QTimer(this))
+    , m_dormant(false)
+    , m_changeTimer(new QTimer(this))
+    , m_statUpdates(0)
+    , m_statSignals(0)
+    , m_writeMutex(QMutex::Recursive)
+{
+    DirCache::instance(); //created here so it lives in the gui thread
+    s_models << this;
     connect(DDataLoader::instance(), SIGNAL(newData(QString)), this, SLOT(newData(QString)));
+    m_changeTimer->setSingleShot(true);
+    m_changeTimer->setInterval(CHANGEBATCH);
+    connect(m_changeTimer, SIGNAL(timeout()), this, SLOT(flushDataChanged()));
+    if (!qgetenv("DFM_MODELSTATS").isEmpty())
+    {
+        //dataChanged per second, to see what a change costs the views
+        connect(this, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(countDataChanged()));
+        QTimer *stats = new QTimer(this);
+        connect(stats, SIGNAL(timeout()), this, SLOT(printStats()));
+        stats->start(1000);
+    }
     connect(m_watcher, SIGNAL(directoryChanged(QString)), this, SLOT(dirChanged(QString)));
-    connect(m_dataGatherer, SIGNAL(nodeGenerated(QString,Node*)), this, SLOT(nodeGenerated(QString,Node*)));
+    connect(m_watcher, SIGNAL(directoryRemoved(QString)), this, SLOT(dirRemoved(QString)));
+    connect(m_watcher, SIGNAL(entriesChanged(QString,QStringList,QStringList,QStringList)), this, SLOT(dirEntriesChanged(QString,QStringList,QStringList,QStringList)));
+    connect(m_dataGatherer, SIGNAL(nodeGenerated(QString,Node*)), this, SLOT(pathResolved(QString,Node*)));
+    m_resolveTimer->setSingleShot(true);
+    m_resolveTimer->setInterval(RESOLVETIMEOUT);
+    connect(m_resolveTimer, SIGNAL(timeout()), this, SLOT(resolveTimedOut()));
     connect(this, SIGNAL(fileRenamed(QString,QString,QString)), DDataLoader::instance(), SLOT(fileRenamed(QString,QString,QString)));
 //    connect(m_timer, SIGNAL(timeout()), this, SLOT(refreshCurrent()));
     connect(DDataLoader::instance(), SIGNAL(noLongerExists(QString)), this, SLOT(fileDeleted(QString)));
@@ -121,17 +198,60 @@ Model::Model(QObject *parent)
     connect(Devices::instance(), SIGNAL(deviceRemoved(Device*)), this, SLOT(updateFileNode()));
 //    connect(this, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(rowsDeleted(QModelIndex,int,int)));
     connect(this, SIGNAL(deleteNodeLater(Node*)), this, SLOT(deleteNode(Node*)));
-    schemeNode("file")->rePopulate();
+    connect(this, SIGNAL(dataChangedLater(QStringList)), this, SLOT(queueDataChanged(QStringList)));
+    //rows come in from the gatherer thread, keep the buckets in step right away
+    connect(this, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(catRowsInserted(QModelIndex,int,int)), Qt::DirectConnection);
+    connect(this, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(catRowsRemoved(QModelIndex,int,int)), Qt::DirectConnection);
+    connect(this, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(catDataChanged(QModelIndex,QModelIndex)), Qt::DirectConnection);
+    connect(this, SIGNAL(layoutAboutToBeChanged()), this, SLOT(invalidateCategories()), Qt::DirectConnection);
+    connect(this, SIGNAL(layoutChanged()), this, SLOT(invalidateCategories()), Qt::DirectConnection);
+    connect(this, SIGNAL(modelReset()), this, SLOT(invalidateCategories()), Qt::DirectConnection);
+    connect(this, SIGNAL(sortingChanged(int,int)), this, SLOT(invalidateCategories()), Qt::DirectConnection);
+    //trim the tree once a dir is loaded and the gatherer is done with it
+    connect(this, SIGNAL(urlLoaded(QUrl)), this, SLOT(evictNodes()), Qt::QueuedConnection);
+    connect(this, SIGNAL(urlLoaded(QUrl)), this, SLOT(prefetchNeighbours()), Qt::QueuedConnection);
+    //mounts are listed by the gatherer, a dead one would hang us here
+    dataGatherer()->populateNode(schemeNode("file"), Worker::Expanded);
 }
 
 Model::~Model()
 {
-    m_dataGatherer->setCancelled(true);
-    m_dataGatherer->wait();
+    m_refs.ref(); //runners still returning deref us, we are going already
+    s_models.removeOne(this);
+    m_dataGatherer->shutdown();
     delete m_schemeMenu;
     delete m_rootNode;
 }
 
+void
+Model::ref()
+{
+    m_refs.ref();
+}
+
+void
+Model::deref()
+{
+    if (m_refs.deref())
+        return;
+    if (QThread::currentThread() == thread())
+        delete this;
+    else
+        deleteLater();
+}
+
+//the tab is closed, whatever still runs finishes
+//on its own and the last runner out deletes us
+void
+Model::dispose()
+{
+    setParent(0);
+    disconnect(DDataLoader::instance(), 0, this, 0);
+    m_watcher->removePaths(m_watcher->directories());
+    m_dataGatherer->detach();
+    deref();
+}
+
 void
 Model::getSort(const QUrl &url)
 {
@@ -159,10 +279,77 @@ Model::nodeGenerated(const QString &path, Node *node)
         return;
 
     m_current = node;
+    touch(node);
+    if (!m_watcher->directories().isEmpty())
+        m_watcher->removePaths(m_watcher->directories());
+    watchDir(path);
     emit urlChanged(QUrl::fromLocalFile(path));
+    dropPlaceholder();
     m_dataGatherer->populateNode(node);
 }
 
+void
+Model::pathResolved(const QString &path, Node *node)
+{
+    if (path != m_pendingPath) //went somewhere else meanwhile
+        return;
+    m_resolveTimer->stop();
+    m_pendingPath.clear();
+    if (node && !node->isDirectory())
+    {
+        node->exec();
+        node = 0;
+    }
+    if (!node)
+        resolveFailed();
+    else
+        nodeGenerated(path, node);
+}
+
+void
+Model::resolveTimedOut()
+{
+    if (m_pendingPath.isEmpty())
+        return;
+    //the mount isnt answering, leave the gatherer to it
+    //and dont try that mount again for a while
+    m_stalledMounts.insert(mountPoint(m_pendingPath), QDateTime::currentMSecsSinceEpoch());
+    qDebug() << "no answer from" << mountPoint(m_pendingPath) << "while resolving" << m_pendingPath;
+    m_pendingPath.clear();
+    m_dataGatherer->abandon(Worker::Generate);
+    resolveFailed();
+}
+
+void
+Model::resolveFailed()
+{
+    //back to where we were, the failed url never made it
+    dropPlaceholder();
+    if (!m_history[Back].isEmpty() && m_history[Back].last() == m_url)
+        m_history[Back].removeLast();
+    const QUrl &previous = m_history[Back].isEmpty() ? QUrl::fromLocalFile(QDir::homePath()) : m_history[Back].takeLast();
+    m_url = QUrl();
+    m_lockHistory = true;
+    setUrl(previous);
+    m_lockHistory = false;
+}
+
+void
+Model::dropPlaceholder()
+{
+    if (!m_placeholder)
+        return;
+    Node *placeholder = m_placeholder;
+    m_placeholder = 0;
+    if (m_current == placeholder)
+        m_current = 0;
+    if (m_currentRoot == placeholder)
+        m_currentRoot = schemeNode("file");
+    if (m_catNode == placeholder)
+        m_catNode = 0;
+    delete placeholder;
+}
+
 bool
 Model::handleFileUrl(QUrl &url, int &hasUrlReady)
 {
@@ -170,29 +357,38 @@ Model::handleFileUrl(QUrl &url, int &hasUrlReady)
     if (file.endsWith(":")) //windows drive...
         file.append("/");
 
-    const QFileInfo fi(file);
-    if (fi.isDir())
-        url = QUrl::fromLocalFile(file);
-    if (!fi.exists())
-        return false;
-
+    //only the tree is looked at here, the disk is left to the
+    //gatherer so a slow or dead mount cant hang the window
     Node *sNode = schemeNode(url.scheme());
     Node *node = sNode->localNode(file);
 
-    if (!fi.isDir() && node)
+    if (node && !node->isDirectory())
     {
         node->exec();
         return false;
     }
-    if (!m_watcher->directories().isEmpty())
-        m_watcher->removePaths(m_watcher->directories());
-    watchDir(file);
+    url = QUrl::fromLocalFile(file);
     m_currentRoot = sNode;
-    if (!node)
-        dataGatherer()->generateNode(file, sNode);
-    else
+    if (node)
+    {
         nodeGenerated(file, node);
-    hasUrlReady = 0;
+        hasUrlReady = 0;
+        return true;
+    }
+
+    const QString &mount = mountPoint(file);
+    if (m_stalledMounts.contains(mount))
+    {
+        if (QDateTime::currentMSecsSinceEpoch() - m_stalledMounts.value(mount) < STALLRETRY)
+            return false;
+        m_stalledMounts.remove(mount);
+    }
+    dropPlaceholder();
+    m_currentRoot = m_current = m_placeholder = new Node(this, url);
+    m_pendingPath = file;
+    m_resolveTimer->start();
+    dataGatherer()->generateNode(file, sNode);
+    hasUrlReady = 1;
     return true;
 }
 
@@ -217,13 +413,10 @@ Model::handleSearchUrl(QUrl &url, int &hasUrlReady)
         return false;
 
     sNode->clearVisible();
-    const QFileInfo fi(searchPath);
-    if (!fi.exists())
-        return false;
-
+    //a path that isnt there just finds nothing, the gatherer finds that out
     m_currentRoot = sNode;
     m_current = new Node(this, url, sNode);
-    m_dataGatherer->search(searchName, fi.filePath(), m_current);
+    m_dataGatherer->search(searchName, searchPath, m_current);
     hasUrlReady = 1;
     return true;
 }
@@ -289,11 +482,14 @@ Model::setUrl(QUrl url)
     if (url.scheme().isEmpty())
         url = QUrl::fromLocalFile(url.toString());
 
+    m_pendingPath.clear();
+    m_resolveTimer->stop();
     bool (Model::*urlHandler)(QUrl &, int &)(getUrlHandler(url));
     int isReady(0);
     if (urlHandler && (this->*urlHandler)(url, isReady))
     {
         DDataLoader::clearQueue();
+        touch(m_current);
         m_url = url;
         m_history[Back] << m_url;
         if (!m_lockHistory)
@@ -302,6 +498,8 @@ Model::setUrl(QUrl url)
             emit urlChanged(m_url);
         if (isReady>1)
             emit urlLoaded(m_url);
+        if (m_current != m_placeholder)
+            dropPlaceholder();
         return true;
     }
     else
@@ -327,13 +525,8 @@ Model::goBack()
         return;
     if (m_history[Back].last() == m_url)
         m_history[Forward] << m_history[Back].takeLast(); //current location to forward
+    //a dir that is gone fails to resolve and resolveFailed() goes back further
     const QUrl &backUrl = m_history[Back].takeLast();
-    if (backUrl.isLocalFile() && !backUrl.path().isEmpty())
-        if (!QFileInfo(backUrl.toLocalFile()).exists())
-        {
-            goBack();
-            return;
-        }
     m_lockHistory=true;
     setUrl(backUrl);
     m_lockHistory=false;
@@ -363,33 +556,45 @@ void
 Model::refresh(const QString &path)
 {
     Node *node = schemeNode("file")->localNode(path);
-    dataGatherer()->populateNode(node);
+    dataGatherer()->populateNode(node, node == m_current ? Worker::Current : Worker::Expanded);
 }
 
 void
 Model::updateFileNode()
 {
-    schemeNode("file")->rePopulate();
+    dataGatherer()->populateNode(schemeNode("file"), Worker::Expanded);
 }
 
 void
 Model::dirChanged(const QString &path)
 {
-    if (QFileInfo(path).exists())
-    {
-        refresh(path);
-        return;
-    }
+    refresh(path);
+}
+
+//the watcher saw the dir itself go, no need to ask the disk
+void
+Model::dirRemoved(const QString &path)
+{
     emit directoryRemoved(path);
     if (Node *n = schemeNode("file")->localNode(path))
     {
         if (n == m_current)
             m_current = 0;
         if (Node *p = n->parent())
-            dataGatherer()->populateNode(p);
+            dataGatherer()->populateNode(p, Worker::Expanded);
     }
 }
 
+void
+Model::dirEntriesChanged(const QString &path, const QStringList &added, const QStringList &removed, const QStringList &changed)
+{
+    Node *n = schemeNode("file")->localNode(path);
+    if (!n || !n->isPopulated())
+        return;
+    //stat'ed by the gatherer, behind anything else writing to the node
+    m_dataGatherer->updateEntries(n, added, removed, changed);
+}
+
 void
 Model::refreshCurrent()
 {
@@ -416,42 +621,123 @@ Model::unWatchDir(const QString &path)
 Qt::ItemFlags
 Model::flags(const QModelIndex &index) const
 {
+    //asked for on every paint, so only what the node already has.
+    //a lazy node is taken as usable until its stat says otherwise
     Node *n = node(index);
+    const bool lazy = n->isLazy();
     Qt::ItemFlags flags = QAbstractItemModel::flags(index);
-    if (n->isWritable()) flags |= Qt::ItemIsEditable;
-    if (n->isDir()) flags |= Qt::ItemIsDropEnabled;
-    if (n->isReadable() && !isWorking()) flags |= Qt::ItemIsSelectable | Qt::ItemIsDragEnabled;
+    if (lazy || n->canWrite()) flags |= Qt::ItemIsEditable;
+    if (n->isDirectory()) flags |= Qt::ItemIsDropEnabled;
+    if ((lazy || n->canRead()) && !isWorking()) flags |= Qt::ItemIsSelectable | Qt::ItemIsDragEnabled;
     return flags;
 }
 
 void
 Model::newData(const QString &file)
 {
-    const QModelIndex &idx = index(QUrl::fromLocalFile(file));
-    if (idx.isValid())
+    ++m_statUpdates;
+    //the loader stat'ed the file when it read it, the node takes
+    //that so asking for the data with its stamp finds it again
+    if (Data *d = DDataLoader::data(file, true))
+    {
+        Node *n = schemeNode("file")->localNode(file);
+        if (!n && m_current)
+            n = m_current->child(file);
+        if (n)
+            n->setStamp(d->stamp);
+    }
+    queueDataChanged(file);
+}
+
+void
+Model::queueDataChanged(const QString &file)
+{
+    m_changedFiles.insert(file);
+    if (!m_changeTimer->isActive())
+        m_changeTimer->start();
+}
+
+void
+Model::queueDataChanged(const QStringList &files)
+{
+    for (int i = 0; i < files.count(); ++i)
+        queueDataChanged(files.at(i));
+}
+
+void
+Model::flushDataChanged()
+{
+    const QSet<QString> files(m_changedFiles);
+    m_changedFiles.clear();
+
+    //rows per parent, rows are looked up now as they might have moved since
+    QHash<Node *, QList<int> > rows;
+    QStringList unresolved;
+    Node *fileNode = schemeNode("file");
+    for (QSet<QString>::const_iterator it = files.constBegin(), end = files.constEnd(); it != end; ++it)
     {
-        emit dataChanged(idx, idx);
-        for (int i = 1; i<columnCount(); ++i)
+        Node *n = fileNode->localNode(*it);
+        Node *p = n && n != m_currentRoot ? n->parent() : 0;
+        const int row = p ? p->rowOf(n) : -1;
+        if (row != -1)
+            rows[p] << row;
+        else
+            unresolved << *it;
+    }
+
+    //search results and such live outside the file tree,
+    //one pass over the current dir finds all of them
+    if (!unresolved.isEmpty() && m_current)
+    {
+        QHash<QString, int> rowOfPath;
+        for (int i = 0; i < m_current->childCount(); ++i)
+            rowOfPath.insert(m_current->child(i)->filePath(), i);
+        for (int i = 0; i < unresolved.count(); ++i)
         {
-            const QModelIndex &sibling = idx.sibling(idx.row(), i);
-            emit dataChanged(sibling, sibling);
+            const int row = rowOfPath.value(unresolved.at(i), -1);
+            if (row != -1)
+                rows[m_current] << row;
         }
     }
-    else
+
+    //neighbouring rows go out as one range, all columns at once
+    const int lastCol = columnCount()-1;
+    for (QHash<Node *, QList<int> >::iterator it = rows.begin(), end = rows.end(); it != end; ++it)
     {
-        const QModelIndex &parent = index(m_url);
-        for (int i = 0; i < rowCount(index(m_url)); ++i)
+        Node *p = it.key();
+        QList<int> &r = it.value();
+        qSort(r);
+        int first = r.first(), last = first;
+        for (int i = 1; i <= r.count(); ++i)
         {
-            const QModelIndex &idx = index(i, 0, parent);
-            if (idx.data(FS::FilePathRole).toString() == file)
+            if (i < r.count() && r.at(i) <= last+1)
             {
-                emit dataChanged(idx, idx);
-                return;
+                last = r.at(i);
+                continue;
             }
+            Node *top = p->child(first), *bottom = p->child(last);
+            if (top && bottom)
+                emit dataChanged(createIndex(first, 0, top), createIndex(last, lastCol, bottom));
+            if (i < r.count())
+                first = last = r.at(i);
         }
     }
 }
 
+void
+Model::countDataChanged()
+{
+    ++m_statSignals;
+}
+
+void
+Model::printStats()
+{
+    if (m_statUpdates || m_statSignals)
+        qDebug() << m_url << "new data for" << m_statUpdates << "files," << m_statSignals << "dataChanged per second";
+    m_statUpdates = m_statSignals = 0;
+}
+
 QVariant
 Model::data(const QModelIndex &index, int role) const
 {
@@ -473,10 +759,10 @@ Model::data(const QModelIndex &index, int role) const
     case FileIconRole:
         return n->icon();
     case FileIsDirRole:
-        return n->isDir();
+        return n->isDirectory();
     case FileHasThumbRole:
     {
-        if (Data *d = DDataLoader::data(n->filePath(), true))
+        if (Data *d = DDataLoader::data(n->filePath(), n->stamp(), true))
             return !d->thumb.isNull();
         return false;
     }
@@ -493,7 +779,7 @@ Model::data(const QModelIndex &index, int role) const
     case UrlRole:
         return n->url();
     case LastModifiedRole:
-        return n->lastModified().toString();
+        return n->isLazy() ? QString() : n->fileModified().toString();
     default: break;
     }
 
@@ -666,14 +952,14 @@ Model::hasChildren(const QModelIndex &parent) const
 {
     //QMutexLocker locker(&m_mutex);
     Node *n = node(parent);
-    return n->hasChildren()||n->isDir();
+    return n->hasChildren()||n->isDirectory();
 }
 
 bool
 Model::canFetchMore(const QModelIndex &parent) const
 {
     //QMutexLocker locker(&m_mutex);
-    return node(parent)->isDir();
+    return node(parent)->isDirectory();
 }
 
 void
@@ -683,8 +969,8 @@ Model::fetchMore(const QModelIndex &parent)
     if (parent.isValid() && parent.column() != 0)
         return;
     Node *n = node(parent);
-    if (n && !n->isPopulated() && n->exists())
-        dataGatherer()->populateNode(n);
+    if (n && !n->isPopulated())
+        dataGatherer()->populateNode(n, Worker::Expanded);
 }
 
 void
@@ -694,6 +980,7 @@ Model::sortNode(Node *n)
         n = m_currentRoot;
     if (!n)
         n = m_rootNode;
+    QMutexLocker writer(&m_writeMutex);
     emit layoutAboutToBeChanged();
     const QModelIndexList &oldList = persistentIndexList();
     QList<QPair<int, Node *> > old;
@@ -726,6 +1013,7 @@ Model::sort(int column, Qt::SortOrder order)
     m_sortOrder = order;
 //    qDebug() << "sort called" << m_url << column << order;
     sortNode();
+    statForSort();
     if (orderChanged)
         emit sortingChanged(column, (int)order);
 
@@ -765,17 +1053,32 @@ Model::setHiddenVisible(bool visible)
         return;
 
     m_showHidden = visible;
+    QMutexLocker writer(&m_writeMutex);
     emit layoutAboutToBeChanged();
     schemeNode("file")->setHiddenVisible(visible);
     emit layoutChanged();
+    writer.unlock();
+    if (visible)
+        statForSort();
     emit hiddenVisibilityChanged(visible);
 }
 
+//sorting here only looks at what the nodes already have, lazy
+//ones sort as empty until the gatherer stats them and sorts again
+void
+Model::statForSort()
+{
+    if (!m_currentRoot || m_currentRoot == m_placeholder)
+        return;
+    if (!Store::config.behaviour.lazyStat || Node::needsStat(m_sortColumn))
+        m_dataGatherer->sortNode(m_currentRoot);
+}
+
 bool
 Model::dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column, const QModelIndex &parent)
 {
     Node *n = node(parent);
-    if (!n->isDir())
+    if (!n->isDirectory())
         return false;
 #if !defined(QT_NO_DBUS)
     //ark extract
@@ -813,11 +1116,13 @@ Model::mkdir(const QModelIndex &parent, const QString &name)
         if (!dir.isAbsolute())
             return QModelIndex();
         m_watcher->blockSignals(true);
+        const QString &file = dir.absoluteFilePath(name);
         if (!dir.mkdir(name))
             QMessageBox::warning(static_cast<QWidget *>(this->QObject::parent()), "There was an error", QString("Could not create folder in %2").arg(dir.path()));
-        n->rePopulate();
+        else if (!n->child(file)) //we know what it is, the watcher brings the rest
+            new Node(this, n->childUrl(file), n, file, Node::ListedDir);
         m_watcher->blockSignals(false);
-        return index(QUrl::fromLocalFile(dir.absoluteFilePath(name)));
+        return index(QUrl::fromLocalFile(file));
     }
     return QModelIndex();
 }
@@ -832,14 +1137,14 @@ QModelIndexList
 Model::category(const QString &cat)
 {
     QModelIndexList categ;
+    QMutexLocker locker(&m_catMutex);
+    updateCategories();
     const QModelIndex &parent = index(m_url);
-    const int count = rowCount(parent);
-    for (int i = 0; i < count; ++i)
+    const QList<int> &rows = m_catRows.value(cat);
+    for (int i = 0; i < rows.count(); ++i)
     {
-        const QModelIndex &child = index(i, 0, parent);
-        if (!child.isValid())
-            continue;
-        if (node(child)->category() == cat)
+        const QModelIndex &child = index(rows.at(i), 0, parent);
+        if (child.isValid())
             categ << child;
     }
     return categ;
@@ -853,21 +1158,364 @@ Model::category(const QModelIndex &fromCat)
 
 QStringList
 Model::categories()
+{
+    QMutexLocker locker(&m_catMutex);
+    updateCategories();
+    //in the order they first show up in the rows
+    QMap<int, QString> cats;
+    for (QHash<QString, QList<int> >::const_iterator it = m_catRows.constBegin(); it != m_catRows.constEnd(); ++it)
+        if (!it.value().isEmpty())
+            cats.insert(it.value().first(), it.key());
+    return cats.values();
+}
+
+void
+Model::updateCategories()
 {
     const QModelIndex &parent = index(m_url);
+    Node *parentNode = node(parent);
     const int count = rowCount(parent);
-    QStringList cats;
+    if (!m_catValid || parentNode != m_catNode || m_rowCat.count() != count)
+    {
+        m_catRows.clear();
+        m_rowCat.clear();
+        for (int i = 0; i < count; ++i)
+        {
+            const QModelIndex &child = index(i, 0, parent);
+            if (!child.isValid())
+            {
+                m_rowCat << QString();
+                continue;
+            }
+            QString cat = node(child)->category();
+            if (cat.isNull())
+                cat = QString("");
+            m_rowCat << cat;
+            m_catRows[cat] << i;
+        }
+        m_catNode = parentNode;
+        m_catValid = true;
+        m_catPending = false;
+        return;
+    }
+    if (!m_catPending)
+        return;
     for (int i = 0; i < count; ++i)
     {
+        if (!m_rowCat.at(i).isNull())
+            continue;
         const QModelIndex &child = index(i, 0, parent);
         if (!child.isValid())
             continue;
+        QString cat = node(child)->category();
+        if (cat.isNull())
+            cat = QString("");
+        m_rowCat[i] = cat;
+        addCatRow(i, cat);
+    }
+    m_catPending = false;
+}
+
+void
+Model::shiftCatRows(const int from, const int by)
+{
+    for (QHash<QString, QList<int> >::iterator it = m_catRows.begin(); it != m_catRows.end(); ++it)
+    {
+        QList<int> &rows = it.value();
+        for (QList<int>::iterator r = qLowerBound(rows.begin(), rows.end(), from); r != rows.end(); ++r)
+            *r += by;
+    }
+}
+
+void
+Model::addCatRow(const int row, const QString &cat)
+{
+    QList<int> &rows = m_catRows[cat];
+    rows.insert(qLowerBound(rows.begin(), rows.end(), row), row);
+}
+
+void
+Model::removeCatRow(const int row)
+{
+    if (row >= m_rowCat.count() || m_rowCat.at(row).isNull())
+        return;
+    const QString &cat = m_rowCat.at(row);
+    QHash<QString, QList<int> >::iterator it = m_catRows.find(cat);
+    if (it == m_catRows.end())
+        return;
+    QList<int> &rows = it.value();
+    QList<int>::iterator r = qBinaryFind(rows.begin(), rows.end(), row);
+    if (r != rows.end())
+        rows.erase(r);
+    if (rows.isEmpty())
+        m_catRows.erase(it);
+}
+
+void
+Model::catRowsInserted(const QModelIndex &parent, int first, int last)
+{
+    QMutexLocker locker(&m_catMutex);
+    if (!m_catValid || node(parent) != m_catNode)
+        return;
+    if (first > m_rowCat.count())
+    {
+        m_catValid = false;
+        return;
+    }
+    const int n = last-first+1;
+    shiftCatRows(first, n);
+    //looked at when someone asks, not here on the gatherer thread
+    for (int i = first; i <= last; ++i)
+        m_rowCat.insert(i, QString());
+    m_catPending = true;
+}
+
+void
+Model::catRowsRemoved(const QModelIndex &parent, int first, int last)
+{
+    QMutexLocker locker(&m_catMutex);
+    if (!m_catValid || node(parent) != m_catNode)
+        return;
+    if (last >= m_rowCat.count())
+    {
+        m_catValid = false;
+        return;
+    }
+    for (int i = first; i <= last; ++i)
+        removeCatRow(i);
+    m_rowCat.erase(m_rowCat.begin()+first, m_rowCat.begin()+last+1);
+    shiftCatRows(last+1, first-last-1);
+}
+
+void
+Model::catDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    QMutexLocker locker(&m_catMutex);
+    if (!m_catValid || !topLeft.isValid() || node(topLeft.parent()) != m_catNode)
+        return;
+    const int last = qMin(bottomRight.row(), m_rowCat.count()-1);
+    for (int i = topLeft.row(); i <= last; ++i)
+    {
+        removeCatRow(i);
+        m_rowCat[i] = QString();
+    }
+    m_catPending = true;
+}
+
+void
+Model::touch(Node *node)
+{
+    //parents get the same tick so they never look older than their children,
+    //the tick is shared so nodes of different tabs compare
+    const qint64 tick = ++s_tick;
+    for (Node *n = node; n; n = n->parent())
+        n->contents()->lastUsed = tick;
+}
+
+void
+Model::keepNode(const Node *node, QSet<const Node *> &keep) const
+{
+    for (const Node *n = node; n && !keep.contains(n); n = n->parent())
+        keep.insert(n);
+}
 
-        if (Node *n = node(child))
-            if (!cats.contains(n->category()))
-                cats << n->category();
+void
+Model::evictionCandidates(Node *node, const QSet<const Node *> &keep, QList<QPair<qint64, Node *> > &candidates) const
+{
+    for (int c = 0; c < Node::ChildrenTypeCount; ++c)
+    {
+        const Node::Children children = (Node::Children)c;
+        for (int i = 0; i < node->childCount(children); ++i)
+            if (Node *child = node->child(i, children))
+                if (child->isDirectory())
+                    evictionCandidates(child, keep, candidates);
     }
-    return cats;
+    //children before parents, a parent evicted first would take them along
+    if (node->isPopulated() && !keep.contains(node))
+        candidates << qMakePair(node->lastUsed(), node);
+}
+
+static bool olderThen(const QPair<qint64, Node *> &a, const QPair<qint64, Node *> &b) { return a.first < b.first; }
+
+//the least recently used dirs of all tabs go first
+void
+Model::evictNodes()
+{
+    const int budget = Store::config.behaviour.nodeCacheSize*1000;
+    if (budget <= 0 || totalNodeCount() <= budget)
+        return;
+
+    QList<QPair<qint64, Node *> > candidates;
+    for (int i = 0; i < s_models.count(); ++i)
+        s_models.at(i)->evictionCandidates(candidates);
+    qStableSort(candidates.begin(), candidates.end(), olderThen);
+
+    //a bit below the budget so we dont evict on every visit
+    const int target = budget - budget/10;
+    for (int i = 0; i < candidates.count() && totalNodeCount() > target; ++i)
+        candidates.at(i).second->evict();
+}
+
+//nothing while the gatherer might still write to the tree
+void
+Model::evictionCandidates(QList<QPair<qint64, Node *> > &candidates)
+{
+    if (!m_dataGatherer->isIdle() || !m_pendingPath.isEmpty())
+        return;
+
+    //what is shown in a view, current or watched stays, with its parents
+    QSet<const Node *> keep;
+    keepNode(m_current, keep);
+    keepNode(m_currentRoot, keep);
+    const QModelIndexList &persistent = persistentIndexList();
+    for (int i = 0; i < persistent.count(); ++i)
+        if (persistent.at(i).isValid())
+            keepNode(node(persistent.at(i)), keep);
+    Node *fileNode = schemeNode("file");
+    const QStringList &watched = m_watcher->directories();
+    for (int i = 0; i < watched.count(); ++i)
+        keepNode(fileNode->localNode(watched.at(i)), keep);
+
+    evictionCandidates(fileNode, keep, candidates);
+}
+
+//a tab nobody looked at for a while lets go of its watches, its
+//runners and everything but the current dir, which is all a
+//view needs when the tab is shown again.
+bool
+Model::sleep()
+{
+    if (m_dormant)
+        return true;
+    if (!m_pendingPath.isEmpty() || isWorking())
+        return false;
+    m_dormant = true;
+    m_dataGatherer->release();
+    m_watcher->removePaths(m_watcher->directories());
+    dropCaches();
+    return true;
+}
+
+void
+Model::dropCaches()
+{
+    if (!m_dormant)
+        return;
+    if (!m_dataGatherer->isIdle())
+    {
+        //released runners still on their way out
+        QTimer::singleShot(100, this, SLOT(dropCaches()));
+        return;
+    }
+    QSet<const Node *> keep;
+    keepNode(m_current, keep);
+    keepNode(m_currentRoot, keep);
+    QList<QPair<qint64, Node *> > candidates;
+    evictionCandidates(schemeNode("file"), keep, candidates);
+    for (int i = 0; i < candidates.count(); ++i)
+        candidates.at(i).second->evict();
+}
+
+void
+Model::wake()
+{
+    if (!m_dormant)
+        return;
+    m_dormant = false;
+    if (!m_current || !m_current->isAbsolute())
+        return;
+    //changes while we slept went unnoticed
+    watchDir(m_current->filePath());
+    m_dataGatherer->populateNode(m_current);
+}
+
+//prefetching never pushes the tree into eviction
+//and stays out of the way of an unresolved path
+bool
+Model::canPrefetch() const
+{
+    if (m_dormant || !m_pendingPath.isEmpty())
+        return false;
+    const int budget = Store::config.behaviour.nodeCacheSize*1000;
+    return budget <= 0 || totalNodeCount() < budget - budget/5;
+}
+
+void
+Model::prefetch(Node *node)
+{
+    if (node && node->isDirectory() && !node->isPopulated() && canPrefetch())
+        m_dataGatherer->populateNode(node, Worker::Prefetch);
+}
+
+void
+Model::prefetch(const QModelIndex &index)
+{
+    if (index.isValid() && index.model() == this)
+        prefetch(node(index));
+}
+
+void
+Model::prefetch(const QStringList &paths)
+{
+    Node *fileNode = schemeNode("file");
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < paths.count() && canPrefetch(); ++i)
+    {
+        const QString &path = paths.at(i);
+        if (Node *n = fileNode->localNode(path))
+        {
+            prefetch(n);
+            continue;
+        }
+        const QString &mount = mountPoint(path);
+        if (m_stalledMounts.contains(mount) && now - m_stalledMounts.value(mount) < STALLRETRY)
+            continue;
+        m_dataGatherer->prefetchPath(path, fileNode);
+    }
+}
+
+//the rows a view shows, lazy ones are stat'ed by the gatherer one
+//batch per dir. as prefetches they never count as working and the
+//latest viewport wins when the user scrolls on.
+void
+Model::statRows(const QModelIndexList &indexes)
+{
+    if (m_dormant)
+        return;
+    QHash<Node *, QStringList> names;
+    for (int i = 0; i < indexes.count(); ++i)
+    {
+        const QModelIndex &index = indexes.at(i);
+        if (!index.isValid() || index.model() != this)
+            continue;
+        Node *n = node(index);
+        Node *p = n->parent();
+        if (n->isLazy() && p && p->isAbsolute())
+            names[p] << n->fileName();
+    }
+    for (QHash<Node *, QStringList>::const_iterator it = names.constBegin(), end = names.constEnd(); it != end; ++it)
+        m_dataGatherer->updateEntries(it.key(), QStringList(), QStringList(), it.value(), Worker::Prefetch);
+}
+
+//where the user most likely goes from here
+void
+Model::prefetchNeighbours()
+{
+    if (!m_current || !m_current->url().isLocalFile())
+        return;
+    prefetch(m_current->parent());
+    QStringList paths;
+    for (int i = m_history[Forward].count()-1; i > -1 && paths.count() < PREFETCHHISTORY; --i)
+        if (m_history[Forward].at(i).isLocalFile())
+            paths << m_history[Forward].at(i).toLocalFile();
+    prefetch(paths);
+}
+
+void
+Model::invalidateCategories()
+{
+    QMutexLocker locker(&m_catMutex);
+    m_catValid = false;
 }
 
 void
@@ -879,6 +1527,7 @@ Model::exec(const QModelIndex &index)
 void
 Model::setFilter(const QString &filter, const QString &path)
 {
+    QMutexLocker writer(&m_writeMutex);
     emit layoutAboutToBeChanged();
     if (!path.isEmpty())
     {
@@ -932,7 +1581,7 @@ Model::endSearch()
 void
 Model::cancelSearch()
 {
-    dataGatherer()->setCancelled(true);
+    dataGatherer()->cancel(Worker::Search);
 }
 
 bool
@@ -971,8 +1620,11 @@ Model::fileName(const QModelIndex &index) const
 
 bool Model::isDir(const QModelIndex &index) const
 {
-    return node(index)->isDir();
+    return node(index)->isDirectory();
 }
+
+//the node itself, its QFileInfo stats once and caches
+//it for the caller, copies share what it found out
 QFileInfo Model::fileInfo(const QModelIndex &index) const
 {
     return *node(index);
@@ -980,7 +1632,7 @@ QFileInfo Model::fileInfo(const QModelIndex &index) const
 
 Node *Model::rootNode() const { return m_currentRoot; }
 
-bool Model::isWorking() const { return m_dataGatherer->isRunning(); }
+bool Model::isWorking() const { return m_dataGatherer->isWorking(); }
 
 QString
 Model::title(const QUrl &url) const
@@ -1031,7 +1683,7 @@ Model::fileDeleted(const QString &path)
     if (!n)
         return;
     if (Node *p = n->parent())
-        m_dataGatherer->populateNode(p);
+        m_dataGatherer->populateNode(p, Worker::Expanded);
 }
 
 void
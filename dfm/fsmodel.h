@@ -27,8 +27,9 @@
 #include <QAbstractItemModel>
 #include <QFileIconProvider>
 #include <QMutex>
+#include <QAtomicInt>
+#include <QSet>
 
-class QFileSystemWatcher;
 class QMenu;
 
 namespace DFM
@@ -51,6 +52,7 @@ public:
 
 class Model;
 class Node;
+class Watcher;
 namespace Worker {class Gatherer;}
 
 class Model : public QAbstractItemModel
@@ -61,6 +63,12 @@ public:
     explicit Model(QObject *parent = 0);
     ~Model();
 
+    //runners hold a ref each, dispose() lets go of ours
+    //so a runner stuck on a dead mount never blocks us
+    void ref();
+    void deref();
+    void dispose();
+
     Qt::ItemFlags flags(const QModelIndex &index) const;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
     bool setData(const QModelIndex &index, const QVariant &value, int role);
@@ -99,7 +107,7 @@ public:
     QModelIndex mkdir(const QModelIndex &parent, const QString &name);
 
     inline Worker::Gatherer *dataGatherer() const { return m_dataGatherer; }
-    inline QFileSystemWatcher *dirWatcher() const { return m_watcher; }
+    inline Watcher *dirWatcher() const { return m_watcher; }
 
     void getSort(const QUrl &url);
     void setSort(const int sortColumn, const int sortOrder);
@@ -128,15 +136,38 @@ public:
     void watchDir(const QString &path);
     void unWatchDir(const QString &path);
 
-    void sortNode(Node *n = 0);
+    void touch(Node *node);
+    void prefetch(const QModelIndex &index);
+    void prefetch(const QStringList &paths);
+    void statRows(const QModelIndexList &indexes);
+    inline int nodeCount() const { return m_nodeCount.fetchAndAddRelaxed(0); }
+
+    bool sleep();
+    void wake();
+    inline bool isDormant() const { return m_dormant; }
+
+    void queueDataChanged(const QString &file);
 
 protected:
     bool (Model::*getUrlHandler(const QUrl &url))(QUrl &, int &);
+    void updateCategories();
+    void shiftCatRows(const int from, const int by);
+    void addCatRow(const int row, const QString &cat);
+    void removeCatRow(const int row);
+    void keepNode(const Node *node, QSet<const Node *> &keep) const;
+    void evictionCandidates(Node *node, const QSet<const Node *> &keep, QList<QPair<qint64, Node *> > &candidates) const;
+    void evictionCandidates(QList<QPair<qint64, Node *> > &candidates);
+    void resolveFailed();
+    bool canPrefetch() const;
+    void prefetch(Node *node);
+    void dropPlaceholder();
+    void statForSort();
 #define URLHANDLER(_VAR_) bool handle##_VAR_##Url(QUrl &url = defaultUrl, int &hasUrlReady = defaultInteger)
     URLHANDLER(File); URLHANDLER(Search); URLHANDLER(Applications); URLHANDLER(Devices); URLHANDLER(Trash);
 #undef URLHANDLER
 
 public slots:
+    void sortNode(Node *n = 0);
     bool setUrl(QUrl url);
     void setUrlFromDynamicPropertyUrl();
     void refresh();
@@ -147,12 +178,27 @@ public slots:
 private slots:
     void newData(const QString &file);
     void dirChanged(const QString &path);
+    void dirRemoved(const QString &path);
+    void dirEntriesChanged(const QString &path, const QStringList &added, const QStringList &removed, const QStringList &changed);
     void nodeGenerated(const QString &path, Node *node);
+    void pathResolved(const QString &path, Node *node);
+    void resolveTimedOut();
     void schemeFromSchemeMenu();
     void refreshCurrent();
     void fileDeleted(const QString &path);
     void updateFileNode();
     void deleteNode(Node *node);
+    void catRowsInserted(const QModelIndex &parent, int first, int last);
+    void catRowsRemoved(const QModelIndex &parent, int first, int last);
+    void catDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void invalidateCategories();
+    void evictNodes();
+    void prefetchNeighbours();
+    void dropCaches();
+    void queueDataChanged(const QStringList &files);
+    void flushDataChanged();
+    void countDataChanged();
+    void printStats();
 
 signals:
     void flowDataChanged(const QModelIndex &start, const QModelIndex &end);
@@ -166,21 +212,51 @@ signals:
     void finishedWorking();
     void urlLoaded(const QUrl &url);
     void deleteNodeLater(Node *node);
+    void dataChangedLater(const QStringList &files);
 
 private:
     Node *m_rootNode, *m_current, *m_currentRoot;
     mutable QMutex m_mutex;
+    //one writer at a time for row inserts, removes and layout changes,
+    //runners and the gui thread both change the tree. always taken before
+    //any node mutex, never while holding one.
+    QMutex m_writeMutex;
     mutable QMap<QString, Node *> m_schemeNodes;
     QHash<QUrl, Node *> m_nodes;
     bool m_showHidden, m_lockHistory;
     Qt::SortOrder m_sortOrder;
     int m_sortColumn;
-    QFileSystemWatcher *m_watcher;
+    Watcher *m_watcher;
     Worker::Gatherer *m_dataGatherer;
     QMenu *m_schemeMenu;
     QUrl m_url;
     QList<QUrl> m_history[Forward+1];
     QTimer *m_timer;
+
+    //rows per category of the current dir, a null
+    //category in m_rowCat is a row not looked at yet
+    mutable QMutex m_catMutex;
+    Node *m_catNode;
+    bool m_catValid, m_catPending;
+    QStringList m_rowCat;
+    QHash<QString, QList<int> > m_catRows;
+
+    mutable QAtomicInt m_nodeCount;
+    QAtomicInt m_refs;
+
+    //a path not in the tree yet is resolved by the gatherer, m_placeholder
+    //stands in as current node and root until it is done. it has no parent
+    //so it never shows up as a row anywhere.
+    Node *m_placeholder;
+    QString m_pendingPath;
+    QTimer *m_resolveTimer;
+    QHash<QString, qint64> m_stalledMounts;
+    bool m_dormant; //hidden tab, no watches, no runners, only the current dir
+
+    //files with new data, handed to the views as row ranges once a frame
+    QSet<QString> m_changedFiles;
+    QTimer *m_changeTimer;
+    int m_statUpdates, m_statSignals; //per second, with DFM_MODELSTATS set
     friend class FlowDataLoader;
     friend class Node;
     friend class Worker::Gatherer;
@@ -21,8 +21,10 @@
 #include "fsnode.h"
 #include "fsmodel.h"
 #include "fsworkers.h"
+#include "fscache.h"
 #include "dataloader.h"
 #include "devices.h"
+#include "config.h"
 
 #include <QSettings>
 #include <QDesktopServices>
@@ -30,69 +32,268 @@
 #include <QDirIterator>
 #include <QDateTime>
 #include <QDebug>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QThread>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QSet>
+
+#include <algorithm>
+
+#if defined(HASGETDENTS)
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+#if defined(ISUNIX)
+#include <sys/stat.h>
+#endif
 
 using namespace DFM;
 using namespace FS;
 
+//number of entries rePopulate() collects before handing them to the model
+#define BATCHSIZE 4096
+
+//lists longer than this are sorted in chunks on the thread pool
+#define PARALLELSORT 16384
+
 static bool lessThen(Node *n1, Node *n2)
 {
-    //dirs always first right?
-    if (n1->isDir() && !n2->isDir())
-        return true;
-    else if (!n1->isDir() && n2->isDir())
-        return false;
-
-    //hidden... last?
-    if (n1->isHidden() && !n2->isHidden())
-        return false;
-    else if (!n1->isHidden() && n2->isHidden())
-        return true;
+    const Node::SortKey &k1 = n1->sortKey(), &k2 = n2->sortKey();
+    if (k1.flags != k2.flags)
+    {
+        //dirs always first right?
+        if ((k1.flags^k2.flags) & Node::SortKey::Dir)
+            return k1.flags & Node::SortKey::Dir;
+        //hidden... last?
+        return !(k1.flags & Node::SortKey::Hidden);
+    }
 
     bool lt = true;
     switch (n1->sortColumn())
     {
-    case 0: lt = n1->name().toLower()<n2->name().toLower(); break; //name
-    case 1: lt = n1->size()<n2->size(); break; //size
+    case 0: lt = k1.name<k2.name; break; //name
+    case 1: lt = k1.stamp.size<k2.stamp.size; break; //size
     case 2: //type
-        if (n1->suffix().toLower()==n2->suffix().toLower())
-            lt = n1->name().toLower()<n2->name().toLower();
+        if (k1.suffix==k2.suffix)
+            lt = k1.name<k2.name;
         else
-            lt = n1->suffix().toLower()<n2->suffix().toLower();
+            lt = k1.suffix<k2.suffix;
         break;
-    case 3: lt = n1->lastModified()<n2->lastModified(); break; //lastModified
-    case 4: lt = n1->permissions()<n2->permissions(); break; //permissions
+    case 3: lt = k1.stamp.mtime<k2.stamp.mtime; break; //lastModified
+    case 4: lt = k1.perms<k2.perms; break; //permissions
     default: break;
     }
     return bool(n1->sortOrder())?!lt:lt;
 }
 
+//case folded utf8, compares bytewise. natural turns every run of
+//digits into '0', its length and the digits without leading zeros
+//so 'file2' comes before 'file10'. a plain '0' never shows up
+//outside such a run so the marker cant clash with the name.
+static QByteArray
+collationKey(const QString &name, const bool natural)
+{
+    const QByteArray &folded = name.toCaseFolded().toUtf8();
+    if (!natural)
+        return folded;
+    QByteArray key;
+    key.reserve(folded.size()+8);
+    const int size = folded.size();
+    for (int i = 0; i < size;)
+    {
+        const char c = folded.at(i);
+        if (c < '0' || c > '9')
+        {
+            key += c;
+            ++i;
+            continue;
+        }
+        const int start = i;
+        while (i < size && folded.at(i) >= '0' && folded.at(i) <= '9')
+            ++i;
+        int digits = start;
+        while (digits < i-1 && folded.at(digits) == '0')
+            ++digits;
+        const int len = i-digits;
+        key += '0';
+        key += char(qMin(len, 255));
+        key.append(folded.constData()+digits, len);
+    }
+    return key;
+}
+
+//the chunks of one sort, whoever is free takes the next one. the
+//caller sorts too so it never waits on a chunk nobody started.
+struct SortChunks
+{
+    Nodes::iterator begin;
+    QList<int> bounds;
+    QAtomicInt next;
+    QSemaphore done;
+    void sortAll()
+    {
+        int i;
+        while ((i = next.fetchAndAddOrdered(1)) < bounds.count()-1)
+        {
+            qStableSort(begin+bounds.at(i), begin+bounds.at(i+1), lessThen);
+            done.release();
+        }
+    }
+};
+
+class SortTask : public QRunnable
+{
+public:
+    explicit SortTask(const QSharedPointer<SortChunks> &chunks) : m_chunks(chunks) {}
+    void run() { m_chunks->sortAll(); }
+
+private:
+    QSharedPointer<SortChunks> m_chunks; //a late task finds nothing left but still needs this
+};
+
+static void
+sortNodes(Nodes &nodes)
+{
+    const int count = nodes.count();
+    const int chunks = qMin(QThread::idealThreadCount(), count/PARALLELSORT);
+    if (chunks < 2)
+    {
+        qStableSort(nodes.begin(), nodes.end(), lessThen);
+        return;
+    }
+    //begin() detaches the list before any thread touches it
+    const QSharedPointer<SortChunks> sort(new SortChunks());
+    const Nodes::iterator begin = sort->begin = nodes.begin();
+    QList<int> &bounds = sort->bounds;
+    for (int i = 0; i <= chunks; ++i)
+        bounds << int(qint64(count)*i/chunks);
+
+    for (int i = 1; i < chunks; ++i)
+        QThreadPool::globalInstance()->start(new SortTask(sort));
+    sort->sortAll();
+    sort->done.acquire(chunks);
+
+    //merging neighbours keeps it stable as a whole
+    for (int width = 1; width < chunks; width *= 2)
+        for (int i = 0; i+width < chunks; i += 2*width)
+            std::inplace_merge(begin+bounds.at(i), begin+bounds.at(i+width), begin+bounds.at(qMin(i+2*width, chunks)), lessThen);
+}
+
+//keys built while natural sorting was toggled are rebuilt here, never
+//goes to the disk so it is all the writer does before sorting
+static void
+checkNameKeys(const Nodes &nodes)
+{
+    const bool natural = Store::config.views.naturalSort;
+    for (int i = 0; i < nodes.count(); ++i)
+        if (nodes.at(i)->sortKey().natural != natural)
+            nodes.at(i)->updateNameKey();
+}
+
+//lazy nodes get stat'ed when the sort column needs more than names,
+//only ever on a copy and before the writer is taken
+static void
+checkSortKeys(const Nodes &nodes)
+{
+    if (nodes.isEmpty())
+        return;
+    checkNameKeys(nodes);
+    if (!Store::config.behaviour.lazyStat || Node::needsStat(nodes.first()->sortColumn()))
+        Node::ensureStat(nodes);
+}
+
+//guards filling in the key of a lazy node, the gui and the gatherer both might
+static QMutex s_statMutex;
+
+//only guards handing out the contents of a node the first time
+static QMutex s_contentsMutex;
+
 Node::Node(Model *model, const QUrl &url, Node *parent, const QString &filePath, const Type t)
     : QFileInfo(filePath)
+    , m_contents(0)
+    , m_parent(parent)
+    , m_model(model)
+    , m_isExe(-1)
+    , m_isLink(-1)
     , m_isPopulated(false)
-    , m_filePath(filePath)
-    , m_filter(QString(""))
+    , m_isDeleted(false)
+    , m_localUrl(false)
+    , m_cacheRef(false)
+    , m_type(t)
+{
+    init(url, filePath);
+    updateSortKey();
+    if (parent)
+        parent->addChild(this);
+}
+
+Node::Node(Model *model, const QUrl &url, Node *parent, const DirCache::Entry &entry)
+    : QFileInfo(entry.path)
+    , m_contents(0)
+    , m_parent(parent)
     , m_model(model)
+    , m_isExe(-1)
+    , m_isLink(-1)
+    , m_isPopulated(false)
+    , m_isDeleted(false)
+    , m_localUrl(false)
+    , m_cacheRef(false)
+    , m_type(File)
+{
+    init(url, entry.path);
+    updateSortKey(entry);
+    if (parent)
+        parent->addChild(this);
+}
+
+Node::Node(Model *model, const QUrl &url, Node *parent, const QString &filePath, const Listed listed)
+    : QFileInfo(filePath)
+    , m_contents(0)
     , m_parent(parent)
-    , m_url(url)
+    , m_model(model)
     , m_isExe(-1)
+    , m_isLink(-1)
+    , m_isPopulated(false)
     , m_isDeleted(false)
-    , m_type(t)
-    , m_invertFilter(false)
+    , m_localUrl(false)
+    , m_cacheRef(false)
+    , m_type(File)
 {
+    init(url, filePath);
+    updateSortKey(listed);
+    if (parent)
+        parent->addChild(this);
+}
+
+void
+Node::init(const QUrl &url, const QString &filePath)
+{
+    QString name;
     if (url.path().isEmpty() && !url.scheme().isEmpty())
-        m_name = url.scheme();
-    else if (!parent)
-        m_name = "--";
+        name = url.scheme();
+    else if (!m_parent)
+        name = "--";
     else if (fileName().isEmpty())
-        m_name = filePath;
+        name = filePath;
     else
-        m_name = fileName();
+        name = fileName();
 
-    if (m_name.isEmpty())
-        m_name = url.toEncoded(QUrl::RemoveScheme);
+    if (name.isEmpty())
+        name = url.toEncoded(QUrl::RemoveScheme);
 
-    if (parent)
-        parent->addChild(this);
+    if (name != fileName())
+        m_name = name;
+    setUrl(url);
+
+    if (m_model)
+        m_model->m_nodeCount.ref();
 }
 
 Node::~Node()
@@ -100,23 +301,97 @@ Node::~Node()
     if (m_parent)
         m_parent->removeChild(this);
     m_parent = 0;
-    if (m_model->m_nodes.contains(m_url))
+    if (!m_localUrl && m_model->m_nodes.contains(m_url))
         m_model->m_nodes.remove(m_url);
+    m_model->m_nodeCount.deref();
+    releaseCache();
+    if (!m_contents)
+        return;
+    //the rows go with us, no need for the children to remove themselves
     for (int i = 0; i < ChildrenTypeCount; ++i)
     {
-        qDeleteAll(m_children[i]);
-        m_children[i].clear();
+        const Nodes children = m_contents->children[i];
+        m_contents->children[i].clear();
+        for (int c = 0; c < children.count(); ++c)
+        {
+            children.at(c)->m_parent = 0;
+            delete children.at(c);
+        }
     }
+    delete m_contents;
+}
+
+Node::Contents
+*Node::contents()
+{
+    if (!m_contents)
+    {
+        QMutexLocker locker(&s_contentsMutex);
+        if (!m_contents)
+            m_contents = new Contents();
+    }
+    return m_contents;
+}
+
+void
+Node::setUrl(const QUrl &url)
+{
+    //most urls are just the path, those are built when asked for
+    m_localUrl = !filePath().isEmpty() && url == QUrl::fromLocalFile(filePath());
+    m_url = m_localUrl ? QUrl() : url;
 }
 
 bool
 Node::isFiltered(const QString &name)
 {
-    if (m_filter.isEmpty())
+    if (!m_contents || m_contents->filter.isEmpty())
         return false;
-    if (m_invertFilter)
-        return name.toLower().contains(m_filter);
-    return !name.toLower().contains(m_filter);
+    if (m_contents->invertFilter)
+        return name.toLower().contains(m_contents->filter);
+    return !name.toLower().contains(m_contents->filter);
+}
+
+QString
+Node::filter() const
+{
+    return m_contents ? m_contents->filter : QString("");
+}
+
+//drops everything below us, the next visit populates again
+void
+Node::evict()
+{
+    Contents *c = m_contents;
+    if (!c)
+        return;
+    QMutexLocker writer(&m_model->m_writeMutex);
+    const int rows = childCount();
+    if (rows)
+        m_model->beginRemoveRows(m_model->createIndex(row(), 0, this), 0, rows-1);
+    Nodes children;
+    c->mutex.lock();
+    for (int i = 0; i < ChildrenTypeCount; ++i)
+    {
+        children += c->children[i];
+        c->children[i].clear();
+    }
+    children += c->toAdd;
+    c->toAdd.clear();
+    c->pathIndex.clear();
+    c->nameIndex.clear();
+    c->urlIndex.clear();
+    c->rows.clear();
+    c->rowsDirty = false;
+    c->mutex.unlock();
+    m_isPopulated = false;
+    releaseCache();
+    if (rows)
+        m_model->endRemoveRows();
+    for (int i = 0; i < children.count(); ++i)
+    {
+        children.at(i)->m_parent = 0;
+        delete children.at(i);
+    }
 }
 
 void
@@ -130,30 +405,70 @@ Node::deleteLater()
 void
 Node::removeChild(Node *node)
 {
-    for (int i = 0; i < ChildrenTypeCount; ++i)
+    Contents *c = m_contents;
+    if (!c)
+        return;
+    removeIndex(node);
+    QMutexLocker writer(&m_model->m_writeMutex);
+    const int r = rowOf(node);
+    if (r != -1)
     {
-        m_mutex.lock();
-        const int idx(m_children[i].indexOf(node));
-        m_mutex.unlock();
-        if (idx != -1)
+        m_model->beginRemoveRows(m_model->createIndex(row(), 0, this), r, r);
+        c->mutex.lock();
+        c->children[Visible].removeAt(r);
+        //only the rows after it move, a clean map is fixed up
+        //in place so removing k rows doesnt rebuild it k times
+        if (!c->rowsDirty)
         {
-            if (!i)
-                m_model->beginRemoveRows(m_model->createIndex(row(), 0, this), idx, idx);
-            m_mutex.lock();
-            m_children[i].removeOne(node);
-            m_mutex.unlock();
-            if (!i)
-                m_model->endRemoveRows();
+            c->rows.remove(node);
+            for (int i = r; i < c->children[Visible].size(); ++i)
+                c->rows[c->children[Visible].at(i)] = i;
         }
+        c->mutex.unlock();
+        m_model->endRemoveRows();
+        return;
     }
+    QMutexLocker locker(&c->mutex);
+    for (int i = Hidden; i < ChildrenTypeCount; ++i)
+        if (c->children[i].removeOne(node))
+            return;
+    c->toAdd.removeOne(node);
+}
+
+void
+Node::addIndex(Node *node)
+{
+    Contents *c = contents();
+    QMutexLocker locker(&c->mutex);
+    if (!node->filePath().isEmpty())
+        c->pathIndex.insert(node->filePath(), node);
+    c->nameIndex.insert(node->name(), node);
+    if (!node->m_localUrl)
+        c->urlIndex.insert(node->m_url, node);
+}
+
+void
+Node::removeIndex(Node *node)
+{
+    Contents *c = m_contents;
+    if (!c)
+        return;
+    QMutexLocker locker(&c->mutex);
+    if (c->pathIndex.value(node->filePath(), 0) == node)
+        c->pathIndex.remove(node->filePath());
+    c->nameIndex.remove(node->name(), node);
+    if (!node->m_localUrl && c->urlIndex.value(node->m_url, 0) == node)
+        c->urlIndex.remove(node->m_url);
 }
 
 void
 Node::insertChild(Node *n, const int i)
 {
-    m_mutex.lock();
-    m_children[Visible].insert(i, n);
-    m_mutex.unlock();
+    Contents *c = contents();
+    c->mutex.lock();
+    c->children[Visible].insert(i, n);
+    c->rowsDirty = true;
+    c->mutex.unlock();
 }
 
 void
@@ -161,11 +476,24 @@ Node::addChild(Node *node)
 {
     if (!node->url().isLocalFile())
         m_model->m_nodes.insert(node->url(), node);
+    addIndex(node);
 
-    if ((node->isHidden() && !m_model->showHidden()))
-        m_children[Hidden] << node;
-    else if (isFiltered(node->name()))
-        m_children[Filtered] << node;
+    Contents *c = contents();
+    if (c->isBatching)
+    {
+        c->toAdd << node;
+        return;
+    }
+
+    const Children to = node->isHiddenFile() && !m_model->showHidden() ? Hidden : isFiltered(node->name()) ? Filtered : Visible;
+    if (to == Visible)
+        checkSortKeys(Nodes() << node); //might stat, not while holding anything
+    QMutexLocker writer(&m_model->m_writeMutex);
+    if (to != Visible)
+    {
+        QMutexLocker locker(&c->mutex);
+        c->children[to] << node;
+    }
     else
     {
         int z = childCount(), i = -1;
@@ -178,42 +506,164 @@ Node::addChild(Node *node)
     }
 }
 
+void
+Node::startBatch()
+{
+    contents()->isBatching = true;
+}
+
+void
+Node::flushBatch()
+{
+    //a cancelled job leaves its entries pending,
+    //the next batch on this node inserts them
+    if (gatherer()->isCancelled())
+        return;
+    Contents *c = contents();
+    const Nodes nodes = c->toAdd;
+    c->toAdd.clear();
+    addChildren(nodes);
+}
+
+void
+Node::endBatch()
+{
+    contents()->isBatching = false;
+    flushBatch();
+}
+
+int
+Node::batchCount() const
+{
+    return m_contents ? m_contents->toAdd.count() : 0;
+}
+
+void
+Node::addChildren(const Nodes &nodes)
+{
+    if (nodes.isEmpty())
+        return;
+    Contents *c = contents();
+    Nodes hidden, filtered, visible;
+    for (Nodes::const_iterator b = nodes.constBegin(), e = nodes.constEnd(); b!=e; ++b)
+    {
+        Node *node = *b;
+        if (node->isHiddenFile() && !m_model->showHidden())
+            hidden << node;
+        else if (isFiltered(node->name()))
+            filtered << node;
+        else
+            visible << node;
+    }
+
+    //sort the chunk first so the model only
+    //sees one insert and one merge per chunk
+    //instead of one insert per entry.
+    checkSortKeys(visible);
+    sortNodes(visible);
+
+    QMutexLocker writer(&m_model->m_writeMutex);
+    c->mutex.lock();
+    c->children[Hidden] += hidden;
+    c->children[Filtered] += filtered;
+    c->mutex.unlock();
+    if (visible.isEmpty())
+        return;
+
+    const int first = childCount();
+    m_model->beginInsertRows(m_model->createIndex(row(), 0, this), first, first+visible.count()-1);
+    c->mutex.lock();
+    c->children[Visible] += visible;
+    c->rowsDirty = true;
+    c->mutex.unlock();
+    m_model->endInsertRows();
+
+    if (!first)
+        return;
+
+    emit m_model->layoutAboutToBeChanged();
+    const QModelIndexList &persistent = m_model->persistentIndexList();
+    QModelIndexList oldList, newList;
+    for (int i = 0; i < persistent.count(); ++i)
+    {
+        const QModelIndex &idx = persistent.at(i);
+        if (static_cast<Node *>(idx.internalPointer())->parent() == this)
+            oldList << idx;
+    }
+
+    c->mutex.lock();
+    std::inplace_merge(c->children[Visible].begin(), c->children[Visible].begin()+first, c->children[Visible].end(), lessThen);
+    c->rowsDirty = true;
+    c->mutex.unlock();
+
+    for (int i = 0; i < oldList.count(); ++i)
+    {
+        const QModelIndex &idx = oldList.at(i);
+        Node *node = static_cast<Node *>(idx.internalPointer());
+        newList << m_model->createIndex(rowOf(node), idx.column(), node);
+    }
+    m_model->changePersistentIndexList(oldList, newList);
+    emit m_model->layoutChanged();
+}
+
 int
 Node::childCount(Children children) const
 {
-    QMutexLocker locker(&m_mutex);
-    return m_children[children].size();
+    const Contents *c = m_contents;
+    if (!c)
+        return 0;
+    QMutexLocker locker(&c->mutex);
+    return c->children[children].size();
 }
 
 Node
-*Node::child(const int c, Children fromChildren) const
+*Node::child(const int i, Children fromChildren) const
 {
-    QMutexLocker locker(&m_mutex);
-    if (c > -1 && c < m_children[fromChildren].size())
-        return m_children[fromChildren].at(c);
+    const Contents *c = m_contents;
+    if (!c)
+        return 0;
+    QMutexLocker locker(&c->mutex);
+    if (i > -1 && i < c->children[fromChildren].size())
+        return c->children[fromChildren].at(i);
     return 0;
 }
 
+//a copy, to look at or stat without holding anything
+Nodes
+Node::children(Children fromChildren) const
+{
+    const Contents *c = m_contents;
+    if (!c)
+        return Nodes();
+    QMutexLocker locker(&c->mutex);
+    return c->children[fromChildren];
+}
+
 Node
 *Node::child(const QString &name, const bool nameIsPath) const
 {
-    QMutexLocker locker(&m_mutex);
-    for (int i = 0; i < ChildrenTypeCount; ++i)
-        for (Nodes::const_iterator b = m_children[i].constBegin(), e = m_children[i].constEnd(); b!=e; ++b)
-            if ((nameIsPath?(*b)->filePath():(*b)->name()) == name)
-                return *b;
-    return 0;
+    const Contents *c = m_contents;
+    if (!c)
+        return 0;
+    QMutexLocker locker(&c->mutex);
+    if (nameIsPath)
+        return c->pathIndex.value(name, 0);
+    return c->nameIndex.value(name, 0);
 }
 
 Node
 *Node::childFromUrl(const QUrl &url) const
 {
-    QMutexLocker locker(&m_mutex);
-    for (int i = 0; i < ChildrenTypeCount; ++i)
-        for (Nodes::const_iterator b = m_children[i].constBegin(); b!=m_children[i].constEnd(); ++b)
-            if ((*b)->url() == url)
-                return *b;
-    return 0;
+    const Contents *c = m_contents;
+    if (!c)
+        return 0;
+    QMutexLocker locker(&c->mutex);
+    //local children are only in the path index
+    if (url.isLocalFile())
+        if (Node *node = c->pathIndex.value(url.toLocalFile(), 0))
+            if (node->url() == url)
+                return node;
+    return c->urlIndex.value(url, 0);
 }
 
 
@@ -229,32 +679,47 @@ Node::row() const
 int
 Node::rowOf(const Node *node) const
 {
-    QMutexLocker locker(&m_mutex);
-    return m_children[Visible].indexOf(const_cast<Node *>(node));
+    const Contents *c = m_contents;
+    if (!c)
+        return -1;
+    QMutexLocker locker(&c->mutex);
+    if (c->rowsDirty)
+    {
+        //rebuilt lazily, inserts and sorts only mark the
+        //map dirty so a refresh doesnt rehash on every row.
+        c->rows.clear();
+        c->rows.reserve(c->children[Visible].size());
+        for (int i = 0; i < c->children[Visible].size(); ++i)
+            c->rows.insert(c->children[Visible].at(i), i);
+        c->rowsDirty = false;
+    }
+    return c->rows.value(node, -1);
 }
 
 Node
 *Node::parent() const
 {
-//    QMutexLocker locker(&m_mutex);
     return m_parent;
 }
 
 bool
 Node::hasChildren() const
 {
-    QMutexLocker locker(&m_mutex);
-    return !m_children[Visible].isEmpty();
+    const Contents *c = m_contents;
+    if (!c)
+        return false;
+    QMutexLocker locker(&c->mutex);
+    return !c->children[Visible].isEmpty();
 }
 
 QIcon
 Node::icon() const
 {
-    if (Devices::instance()->mounts().contains(m_filePath))
+    if (Devices::instance()->mounts().contains(filePath()))
         return FileIconProvider::typeIcon(FileIconProvider::Drive);
-    QIcon icon = FileIconProvider::fileIcon(*this);
-    if (icon.pixmap(16).isNull())
-        icon = FileIconProvider::typeIcon(isDir()?FileIconProvider::Folder:FileIconProvider::File);
+    //painted all the time, so only what the sort key knows.
+    //the icon of the mime type comes with the data
+    const QIcon &icon = FileIconProvider::typeIcon(isDirectory()?FileIconProvider::Folder:FileIconProvider::File);
     if (Data *d = moreData())
     {
         if (!d->thumb.isNull())
@@ -267,10 +732,130 @@ Node::icon() const
 bool
 Node::isPopulated() const
 {
-    QMutexLocker locker(&m_mutex);
     return m_isPopulated;
 }
 
+void
+Node::updateSortKey()
+{
+    StatBatch::Results results;
+    StatBatch::stat(QStringList() << filePath(), results);
+    updateSortKey(results.at(0));
+    m_isLink = -1;
+}
+
+//only what the name gives, the rest of the key stays as it is
+void
+Node::updateNameKey()
+{
+    m_sortKey.natural = Store::config.views.naturalSort;
+    m_sortKey.name = collationKey(name(), m_sortKey.natural);
+    m_sortKey.suffix = suffix().toCaseFolded().toUtf8();
+}
+
+//what another model already stat'ed
+void
+Node::updateSortKey(const DirCache::Entry &entry)
+{
+    m_sortKey.natural = Store::config.views.naturalSort;
+    m_sortKey.name = collationKey(name(), m_sortKey.natural);
+    m_sortKey.suffix = suffix().toCaseFolded().toUtf8();
+    m_sortKey.stamp = entry.stamp;
+    m_sortKey.perms = entry.perms;
+    m_sortKey.flags = entry.flags;
+    m_sortKey.lazy = false;
+}
+
+//everything but the disk, the type comes from the dir entry
+//and hidden is just the leading dot on the platforms we list lazily
+void
+Node::updateSortKey(const Listed listed)
+{
+    m_sortKey.natural = Store::config.views.naturalSort;
+    m_sortKey.name = collationKey(name(), m_sortKey.natural);
+    m_sortKey.suffix = suffix().toCaseFolded().toUtf8();
+    m_sortKey.stamp = FileStamp();
+    m_sortKey.perms = 0;
+    m_sortKey.flags = (listed == ListedDir?SortKey::Dir:0)|(fileName().startsWith(QLatin1Char('.'))?SortKey::Hidden:0);
+    m_sortKey.lazy = true;
+    m_isLink = 0; //links are never listed lazily, the entry type says so
+}
+
+//what a batched stat found
+void
+Node::updateSortKey(const StatBatch::Result &stat)
+{
+    m_sortKey.natural = Store::config.views.naturalSort;
+    m_sortKey.name = collationKey(name(), m_sortKey.natural);
+    m_sortKey.suffix = suffix().toCaseFolded().toUtf8();
+    m_sortKey.stamp = stat.stamp;
+    m_sortKey.perms = stat.perms;
+    m_sortKey.flags = (stat.isDir?SortKey::Dir:0)|(QFileInfo::isHidden()?SortKey::Hidden:0); //the name on unix, no disk
+    m_sortKey.lazy = false;
+}
+
+//what the data loader found when it read the file, newer than what we
+//have when the node wasnt stat'ed since. lazy nodes get the whole stat.
+void
+Node::setStamp(const FileStamp &stamp)
+{
+    QMutexLocker locker(&s_statMutex);
+    if (m_sortKey.lazy || stamp.isNull() || stamp.mtime < m_sortKey.stamp.mtime)
+        return;
+    m_sortKey.stamp = stamp;
+}
+
+//not in the sort key, asked for once and only when shown
+bool
+Node::isSymLink() const
+{
+    if (m_isLink == -1)
+    {
+#if defined(ISUNIX)
+        struct stat st;
+        m_isLink = !lstat(QFile::encodeName(filePath()).constData(), &st) && S_ISLNK(st.st_mode);
+#else
+        m_isLink = QFileInfo(filePath()).isSymLink();
+#endif
+    }
+    return m_isLink;
+}
+
+//the lazy ones of nodes in one batch
+void
+Node::ensureStat(const Nodes &nodes)
+{
+    Nodes lazy;
+    QStringList files;
+    for (int i = 0; i < nodes.count(); ++i)
+        if (nodes.at(i)->sortKey().lazy)
+        {
+            lazy << nodes.at(i);
+            files << nodes.at(i)->filePath();
+        }
+    if (lazy.isEmpty())
+        return;
+    StatBatch::Results results;
+    StatBatch::stat(files, results);
+    QMutexLocker locker(&s_statMutex);
+    for (int i = 0; i < lazy.count(); ++i)
+    {
+        const Node *node = lazy.at(i);
+        if (!node->m_sortKey.lazy)
+            continue;
+        node->m_sortKey.stamp = results.at(i).stamp;
+        node->m_sortKey.perms = results.at(i).perms;
+        node->m_sortKey.lazy = false;
+    }
+}
+
+//size, lastModified and permissions, name and type sort on what the listing gave us
+bool
+Node::needsStat(const int sortColumn)
+{
+    return sortColumn == 1 || sortColumn == 3 || sortColumn == 4;
+}
+
 int Node::sortColumn() const { return m_model->sortColumn(); }
 
 Qt::SortOrder Node::sortOrder() const { return m_model->sortOrder(); }
@@ -290,7 +875,7 @@ Node::mimeType() const
 QString
 Node::fileType() const
 {
-    if (isDir())
+    if (isDirectory())
         return QString("directory");
 
     if (Data *d = moreData())
@@ -301,13 +886,13 @@ Node::fileType() const
 Data
 *Node::moreData() const
 {
-    return DDataLoader::data(m_filePath, m_model->isWorking());
+    return DDataLoader::data(filePath(), stamp(), m_model->isWorking());
 }
 
 QString
 Node::permissionsString() const
 {
-    const QFile::Permissions p = permissions();
+    const QFile::Permissions p = filePermissions();
     QString perm;
     perm.append(p.testFlag(QFile::ReadUser)?"R, ":"-, ");
     perm.append(p.testFlag(QFile::WriteUser)?"W, ":"-, ");
@@ -322,13 +907,17 @@ Node::rename(const QString &newName)
     const QString &newFilePath = dir().absoluteFilePath(newName);
     if (QFile::rename(oldFilePath, newFilePath))
     {
-        m_filePath = newFilePath;
-        m_name = newName;
-        setFile(m_filePath);
-        QString newUrl = m_url.toString();
+        if (m_parent)
+            m_parent->removeIndex(this);
+        QString newUrl = url().toString();
         newUrl.replace(oldFilePath, newFilePath); //TODO: better url renaming...
+        setFile(newFilePath);
+        m_name = newName == fileName() ? QString() : newName;
         setUrl(QUrl(newUrl));
+        if (m_parent)
+            m_parent->addIndex(this);
         refresh();
+        updateSortKey();
         return true;
     }
     return false;
@@ -339,17 +928,17 @@ Node::category() const
 {
 //    if (m_parent && m_parent == static_cast<Node *>(&m_model->m_rootNode))
 //        return QObject::tr("scheme");
-    if (isHidden())
-        return QString(isDir()?"hidden directory":"hidden file");
+    if (isHiddenFile())
+        return QString(isDirectory()?"hidden directory":"hidden file");
     switch (sortColumn())
     {
-    case 0: return isDir()?QObject::tr("directory"):name().at(0).toLower();
-    case 1: return QObject::tr(isDir()?"directory":size()<1048576?"small":size()<1073741824?"medium":"large");
+    case 0: return isDirectory()?QObject::tr("directory"):name().at(0).toLower();
+    case 1: return QObject::tr(isDirectory()?"directory":fileSize()<1048576?"small":fileSize()<1073741824?"medium":"large");
     case 2: return data(2).toString();
     case 3:
     {
         int y,m,d;
-        lastModified().date().getDate(&y, &m, &d);
+        fileModified().date().getDate(&y, &m, &d);
         return QString("%1 %2").arg(QString::number(y), QString::number(m));
     }
     default: return QString("-"); break;
@@ -359,16 +948,18 @@ Node::category() const
 QVariant
 Node::data(const int column) const
 {
-    if (exists())
+    //a lazy node shows what its dir entry said,
+    //the rest comes once the shown rows are stat'ed
+    if (fileExists())
         switch (column)
         {
         case 0: return name(); break;
-        case 1: return isDir()?(moreData()?moreData()->count:QString("--")):Ops::prettySize(size()); break;
+        case 1: return isDirectory()?(moreData()?moreData()->entries():QString("--")):isLazy()?QString():Ops::prettySize(fileSize()); break;
         case 2:
         {
             if (isSymLink())
                 return QString("symlink");
-            else if (isDir())
+            else if (isDirectory())
                 return QString("directory");
             else if (suffix().isEmpty())
                 return QString("file");
@@ -376,39 +967,37 @@ Node::data(const int column) const
                 return suffix();
             break;
         }
-        case 3: return lastModified(); break;
-        case 4: return permissionsString(); break;
+        case 3: return isLazy()?QVariant():QVariant(fileModified()); break;
+        case 4: return isLazy()?QString():permissionsString(); break;
         default: return QString("--");
         }
-    return !column?m_name:QString("--");
+    return !column?name():QString("--");
 }
 
 Node
 *Node::localNode(const QString &path, bool checkOnly)
 {
-    QFileInfo fi(path);
-    if ((!fi.exists() || !fi.isAbsolute()) && !checkOnly)
-        return 0;
-
-    QStringList paths;
-    QDir dir;
-
-    if (fi.isDir())
-        dir = QDir(path);
-    else
+    if (!checkOnly)
     {
-        dir = fi.dir();
-        paths << fi.absoluteFilePath();
+        const QFileInfo fi(path);
+        if (!fi.exists() || !fi.isAbsolute())
+            return 0;
     }
 
-    Node *n = this;
-    do
-    {
-        const QString &p = dir.absolutePath();
-        paths.prepend(p);
-    }
-    while (dir.cdUp());
+    //the ancestors come from the string alone, a lookup
+    //that only checks the tree must never touch the disk
+    const QString &clean = QDir::cleanPath(QDir::fromNativeSeparators(path));
+    if (QDir::isRelativePath(clean))
+        return 0;
+    QStringList paths;
+    int slash = clean.indexOf('/');
+    paths << clean.left(slash+1);
+    while ((slash = clean.indexOf('/', slash+1)) != -1)
+        paths << clean.left(slash);
+    if (clean.length() > paths.last().length())
+        paths << clean;
 
+    Node *n = this;
     while (!paths.isEmpty() && n)
         n = n->nodeFromLocalPath(paths.takeFirst(), checkOnly);
     return n;
@@ -424,28 +1013,31 @@ Node
         else
             rePopulate();
     }
-    for (int i = 0; i < ChildrenTypeCount; ++i)
+    Node *node = child(path);
+    if (!node || isFiltered(node->name()))
+        return 0;
+    if (rowOf(node) != -1)
+        return node;
+
+    Contents *contents = m_contents; //there is a child so there are contents
+    for (int i = Hidden; i < ChildrenTypeCount; ++i)
     {
-        int c = childCount(i);
-        while (--c > -1)
-        {
-            Node *node = child(c, i);
-            if (node && node->filePath() == path && !isFiltered(node->name()))
-            {
-                if (i)
-                {
-                    const int r = childCount();
-                    m_model->beginInsertRows(m_model->createIndex(row(), 0, this), r, r);
-                    m_mutex.lock();
-                    m_children[Visible] << m_children[i].takeAt(c);
-                    m_mutex.unlock();
-                    m_model->endInsertRows();
-                }
-                return node;
-            }
-        }
+        contents->mutex.lock();
+        const int c = contents->children[i].indexOf(node);
+        contents->mutex.unlock();
+        if (c == -1)
+            continue;
+        QMutexLocker writer(&m_model->m_writeMutex);
+        const int r = childCount();
+        m_model->beginInsertRows(m_model->createIndex(row(), 0, this), r, r);
+        contents->mutex.lock();
+        contents->children[Visible] << contents->children[i].takeAt(c);
+        contents->rowsDirty = true;
+        contents->mutex.unlock();
+        m_model->endInsertRows();
+        break;
     }
-    return 0;
+    return node;
 }
 
 void
@@ -455,11 +1047,22 @@ Node::sort()
     if (!i)
         return;
 
+    //nothing adds or removes rows while we hold the writer, so we sort
+    //a copy and only lock to put it back. lazy nodes sort on what
+    //they have, the gatherer stats them and sorts again.
+    QMutexLocker writer(&m_model->m_writeMutex);
     if (i > 1)
     {
-        m_mutex.lock();
-        qStableSort(m_children[Visible].begin(), m_children[Visible].end(), lessThen);
-        m_mutex.unlock();
+        Contents *c = m_contents;
+        c->mutex.lock();
+        Nodes visible = c->children[Visible];
+        c->mutex.unlock();
+        checkNameKeys(visible);
+        sortNodes(visible);
+        c->mutex.lock();
+        c->children[Visible] = visible;
+        c->rowsDirty = true;
+        c->mutex.unlock();
     }
 
     while (--i > -1)
@@ -473,23 +1076,35 @@ Node::sort()
 void
 Node::setHiddenVisible(bool visible)
 {
+    Contents *c = m_contents;
+    if (!c)
+        return;
+    QMutexLocker writer(&m_model->m_writeMutex);
     if (visible)
     {
-        m_mutex.lock();
-        m_children[Visible]+=m_children[Hidden];
-        qStableSort(m_children[Visible].begin(), m_children[Visible].end(), lessThen);
-        m_children[Hidden].clear();
-        m_mutex.unlock();
+        c->mutex.lock();
+        Nodes nodes = c->children[Visible] + c->children[Hidden];
+        c->mutex.unlock();
+        checkNameKeys(nodes); //stat'ed before, by whoever called us
+        sortNodes(nodes);
+        c->mutex.lock();
+        c->children[Visible] = nodes;
+        c->children[Hidden].clear();
+        c->rowsDirty = true;
+        c->mutex.unlock();
     }
     else
     {
         int i = childCount();
         while (--i > -1)
         {
-            m_mutex.lock();
-            if (m_children[Visible].at(i)->isHidden())
-                m_children[Hidden] << m_children[Visible].takeAt(i);
-            m_mutex.unlock();
+            c->mutex.lock();
+            if (c->children[Visible].at(i)->isHiddenFile())
+            {
+                c->children[Hidden] << c->children[Visible].takeAt(i);
+                c->rowsDirty = true;
+            }
+            c->mutex.unlock();
         }
     }
     int i = childCount();
@@ -504,45 +1119,52 @@ Node::setHiddenVisible(bool visible)
 void
 Node::clearVisible()
 {
-    qDeleteAll(m_children[Visible]);
+    if (!m_contents)
+        return;
+    //the children take themselves out of the list
+    const Nodes visible = m_contents->children[Visible];
+    qDeleteAll(visible);
 }
 #include <unistd.h>
 void
 Node::setFilter(const QString &filter)
 {
     const QString low(filter.toLower());
-    if (low == m_filter || model()->isWorking())
+    if (low == this->filter() || model()->isWorking())
         return;
 
-    m_filter = low;
-    m_invertFilter = m_filter.startsWith("!");
-    if (m_invertFilter)
-        m_filter.remove(0, 1);
+    QMutexLocker writer(&m_model->m_writeMutex);
+    Contents *c = contents();
+    c->filter = low;
+    c->invertFilter = c->filter.startsWith("!");
+    if (c->invertFilter)
+        c->filter.remove(0, 1);
     emit m_model->layoutAboutToBeChanged();
     const QModelIndexList oldList(m_model->persistentIndexList());
     QList<QPair<int, Node *> > old;
     for (int i = 0; i < oldList.count(); ++i)
         old << QPair<int, Node *>(oldList.at(i).column(), m_model->node(oldList.at(i)));
 
-    m_mutex.lock();
+    c->mutex.lock();
     //add unfiltered to filter...
-    if (!m_filter.isEmpty())
+    if (!c->filter.isEmpty())
     for (int i = 0; i < Filtered; ++i)
     {
-        int c = m_children[i].count();
-        while (--c > -1)
-            if (isFiltered(m_children[i].at(c)->name()))
-                m_children[Filtered] << m_children[i].takeAt(c);
+        int n = c->children[i].count();
+        while (--n > -1)
+            if (isFiltered(c->children[i].at(n)->name()))
+                c->children[Filtered] << c->children[i].takeAt(n);
     }
     //show previously filtered...
-    int f = m_children[Filtered].count();
+    int f = c->children[Filtered].count();
     while (--f > -1)
     {
-        Node *n(m_children[Filtered].at(f));
+        Node *n(c->children[Filtered].at(f));
         if (!isFiltered(n->name()))
-            m_children[n->isHidden() && !showHidden() ? Hidden : Visible] << m_children[Filtered].takeAt(f);
+            c->children[n->isHiddenFile() && !showHidden() ? Hidden : Visible] << c->children[Filtered].takeAt(f);
     }
-    m_mutex.unlock();
+    c->rowsDirty = true;
+    c->mutex.unlock();
 
     QModelIndexList newList;
     for (int i = 0; i < old.count(); ++i)
@@ -566,15 +1188,29 @@ Node::setFilter(const QString &filter)
 void
 Node::removeDeleted()
 {
+    Nodes nodes;
+    QStringList files;
     for (int i = 0; i < ChildrenTypeCount; ++i)
-    {
-        int c = childCount(i);
-        while (--c > -1)
+        for (int c = childCount(i)-1; c > -1; --c)
         {
             Node *node = child(c, i);
-            node->refresh();
-            if (!node->exists())
-                node->deleteLater();
+            if (node->sortKey().lazy) //the listing tells if it is still there
+                continue;
+            nodes << node;
+            files << node->filePath();
+        }
+    StatBatch::Results results;
+    StatBatch::stat(files, results);
+    for (int i = 0; i < nodes.count() && !gatherer()->isCancelled(); ++i)
+    {
+        Node *node = nodes.at(i);
+        const StatBatch::Result &r = results.at(i);
+        if (r.gone)
+            node->deleteLater();
+        else if (r.exists())
+        {
+            node->refresh(); //forget the old stat, asked again when shown
+            node->updateSortKey(r);
         }
     }
 }
@@ -585,26 +1221,24 @@ Node::rePopulate()
     if (gatherer()->isCancelled())
         return;
 
-    if (m_url == m_model->m_url)
-        m_model->getSort(m_url);
+    if (url() == m_model->m_url)
+        m_model->getSort(url());
 
     if (isPopulated())
     {
         removeDeleted();
+        if (showHidden()) //stat'ed here, setHiddenVisible() holds the writer
+            checkSortKeys(children(Hidden));
         setHiddenVisible(showHidden());
     }
 
     if (isAbsolute())
     {
-        QDirIterator it(filePath(), allEntries);
-        while (it.hasNext() && !gatherer()->isCancelled())
-        {
-            const QString &file = it.next();
-            QString url = m_url.toString();
-            url.append(file.mid(file.lastIndexOf("/")+(url.endsWith("/"))));
-            if (!child(file))
-                new Node(m_model, QUrl(url), this, file);
-        }
+        //the first population takes what another model already listed
+        if (isPopulated() || !listFromCache())
+            listFromDisk();
+        if (gatherer()->isCancelled()) //partial, whoever comes next finishes it
+            return;
     }
     else if (parent() == m_model->m_rootNode)
     {
@@ -619,12 +1253,10 @@ Node::rePopulate()
     else
         return;
 
-    m_mutex.lock();
     m_isPopulated = true;
-    m_mutex.unlock();
 
-//    qDebug() << m_url << m_model->m_url;
-    if (m_url.path() == m_model->m_url.path())
+//    qDebug() << url() << m_model->m_url;
+    if (url().path() == m_model->m_url.path())
         emit m_model->urlLoaded(url());
 
     for (int i = 0; i < childCount(); ++i)
@@ -635,16 +1267,259 @@ Node::rePopulate()
     }
 }
 
+//another model already listed this dir, take its entries
+bool
+Node::listFromCache()
+{
+    DirCache::Entries entries;
+    if (!DirCache::instance()->acquire(filePath(), entries))
+        return false;
+    if (m_cacheRef) //lost the listing in between, drop the old ref
+        DirCache::instance()->release(filePath());
+    m_cacheRef = true;
+    startBatch();
+    for (int i = 0; i < entries.count() && !gatherer()->isCancelled(); ++i)
+    {
+        const DirCache::Entry &e = entries.at(i);
+        if (child(e.path))
+            continue;
+        if (e.stamp.isNull()) //a lazy entry, never stat'ed so nothing to share
+            new Node(m_model, childUrl(e.path), this, e.path, (e.flags & SortKey::Dir) ? ListedDir : ListedFile);
+        else
+            new Node(m_model, childUrl(e.path), this, e);
+        if (batchCount() == BATCHSIZE)
+            flushBatch();
+    }
+    endBatch();
+    return true;
+}
+
+void
+Node::listFromDisk()
+{
+    //stamp before listing, a change while we list makes the next acquire miss
+    const FileStamp &dirStamp = FileStamp::fromFile(filePath());
+    DirCache::Entries entries;
+    startBatch();
+#if defined(HASGETDENTS)
+    const bool complete = listEntries(entries);
+    if (!complete)
+#endif
+    {
+        QDirIterator it(filePath(), allEntries);
+        while (it.hasNext() && !gatherer()->isCancelled())
+        {
+            const QString &file = it.next();
+            Node *node = child(file);
+            if (!node)
+                node = new Node(m_model, childUrl(file), this, file);
+            DirCache::Entry e;
+            e.path = file;
+            e.stamp = node->sortKey().stamp;
+            e.perms = node->sortKey().perms;
+            e.flags = node->sortKey().flags;
+            entries << e;
+            if (batchCount() == BATCHSIZE)
+                flushBatch();
+        }
+    }
+    endBatch();
+    if (gatherer()->isCancelled())
+        return;
+#if defined(HASGETDENTS)
+    //getdents64 failed, whatever we have is not the whole dir
+    if (!complete)
+        return;
+#endif
+
+    //lazy nodes are never stat'ed by removeDeleted(), gone is what the listing didnt have
+    QSet<QString> listed;
+    for (int i = 0; i < entries.count(); ++i)
+        listed.insert(entries.at(i).path);
+    for (int i = 0; i < ChildrenTypeCount; ++i)
+        for (int c = childCount(i)-1; c > -1; --c)
+        {
+            Node *node = child(c, i);
+            if (node->sortKey().lazy && !listed.contains(node->filePath()))
+                node->deleteLater();
+        }
+
+    DirCache::instance()->store(filePath(), entries, dirStamp, !m_cacheRef);
+    m_cacheRef = true;
+}
+
+#if defined(HASGETDENTS)
+
+//what getdents64 hands us, glibc doesnt export it everywhere
+struct LinuxDirent64
+{
+    quint64 ino;
+    qint64 off;
+    unsigned short reclen;
+    unsigned char type;
+    char name[1];
+};
+
+//names and types only, no stat per entry. links and filesystems
+//that dont fill d_type get a real node, those need the stat anyway
+bool
+Node::listEntries(DirCache::Entries &entries)
+{
+    const int fd = open(QFile::encodeName(filePath()).constData(), O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if (fd == -1)
+        return false;
+    const QString &prefix = filePath().endsWith(QLatin1Char('/')) ? filePath() : filePath() + QLatin1Char('/');
+    quint64 buf[4096]; //32k, aligned for the dirents
+    while (!gatherer()->isCancelled())
+    {
+        const long n = syscall(SYS_getdents64, fd, buf, sizeof buf);
+        if (n < 0)
+        {
+            close(fd);
+            entries.clear();
+            return false;
+        }
+        if (!n)
+            break;
+        for (long pos = 0; pos < n;)
+        {
+            const LinuxDirent64 *d = reinterpret_cast<const LinuxDirent64 *>(reinterpret_cast<const char *>(buf)+pos);
+            pos += d->reclen;
+            const char *name = d->name;
+            if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+                continue;
+            const QString &file = prefix + QFile::decodeName(name);
+            Node *node = child(file);
+            if (!node)
+            {
+                if (d->type == DT_LNK || d->type == DT_UNKNOWN)
+                    node = new Node(m_model, childUrl(file), this, file);
+                else
+                    node = new Node(m_model, childUrl(file), this, file, d->type == DT_DIR ? ListedDir : ListedFile);
+            }
+            DirCache::Entry e;
+            e.path = file;
+            e.stamp = node->sortKey().stamp;
+            e.perms = node->sortKey().perms;
+            e.flags = node->sortKey().flags;
+            entries << e;
+            if (batchCount() == BATCHSIZE)
+                flushBatch();
+        }
+    }
+    close(fd);
+    return true;
+}
+
+#endif
+
+void
+Node::releaseCache()
+{
+    if (!m_cacheRef)
+        return;
+    m_cacheRef = false;
+    DirCache::instance()->release(filePath());
+}
+
+QUrl
+Node::childUrl(const QString &file) const
+{
+    QString url = this->url().toString();
+    url.append(file.mid(file.lastIndexOf("/")+(url.endsWith("/"))));
+    return QUrl(url);
+}
+
+//what the watcher saw come in, stat'ed in one batch by the gatherer
+void
+Node::insertEntries(const QStringList &names)
+{
+    if (names.isEmpty())
+        return;
+    const QDir dir(filePath());
+    QStringList files;
+    for (int i = 0; i < names.count(); ++i)
+        files << dir.absoluteFilePath(names.at(i));
+    StatBatch::Results results;
+    StatBatch::stat(files, results);
+    startBatch();
+    for (int i = 0; i < files.count(); ++i)
+    {
+        const QString &file = files.at(i);
+        const StatBatch::Result &r = results.at(i);
+        Node *node = child(file);
+        if (!r.exists())
+        {
+            if (node && r.gone)
+                node->deleteLater();
+            continue;
+        }
+        if (!node) //batched, the key is filled in before anyone sorts on it
+            node = new Node(m_model, childUrl(file), this, file, r.isDir ? ListedDir : ListedFile);
+        else
+            node->refresh();
+        node->updateSortKey(r);
+        node->m_isLink = -1;
+    }
+    endBatch();
+}
+
+void
+Node::removeEntries(const QStringList &names)
+{
+    const QDir dir(filePath());
+    for (int i = 0; i < names.count(); ++i)
+        if (Node *node = child(dir.absoluteFilePath(names.at(i))))
+            node->deleteLater();
+}
+
+void
+Node::updateEntries(const QStringList &names)
+{
+    const QDir dir(filePath());
+    Nodes nodes;
+    QStringList files;
+    for (int i = 0; i < names.count(); ++i)
+        if (Node *node = child(dir.absoluteFilePath(names.at(i))))
+        {
+            nodes << node;
+            files << node->filePath();
+        }
+    if (nodes.isEmpty())
+        return;
+    StatBatch::Results results;
+    StatBatch::stat(files, results);
+    QStringList changed;
+    for (int i = 0; i < nodes.count(); ++i)
+    {
+        Node *node = nodes.at(i);
+        const StatBatch::Result &r = results.at(i);
+        if (r.gone)
+            node->deleteLater();
+        else if (r.exists())
+        {
+            node->refresh();
+            node->updateSortKey(r);
+            node->m_isLink = -1;
+            changed << node->filePath();
+        }
+    }
+    if (!changed.isEmpty()) //the views hear of it from the gui thread
+        emit m_model->dataChangedLater(changed);
+}
+
 bool
 Node::isExec() const
 {
     if (m_isExe == -1)
     {
+        if (isLazy()) //no permissions yet, asked again once stat'ed
+            return false;
         if (Data *d = moreData())
         {
             const bool exeSuffix = bool(suffix() == "exe");
             const bool exeFileInfo = mimeType().contains("executable", Qt::CaseInsensitive)||d->fileType.contains("executable", Qt::CaseInsensitive);
-            if (isExecutable() && (exeSuffix || exeFileInfo && !isDir()))
+            if (canExecute() && (exeSuffix || exeFileInfo && !isDirectory()))
                 m_isExe = 1;
             else
                 m_isExe = 0;
@@ -660,12 +1535,12 @@ Node::exec()
     if (!isAbsolute())
         return;
 
-    if (isDir())
-        m_model->setUrl(m_url);
+    if (isDirectory())
+        m_model->setUrl(url());
     else if (isExec())
-        QProcess::startDetached(m_filePath);
+        QProcess::startDetached(filePath());
     else
-        QDesktopServices::openUrl(QUrl::fromLocalFile(m_filePath));
+        QDesktopServices::openUrl(QUrl::fromLocalFile(filePath()));
 }
 
 //-----------------------------------------------------------------------------
@@ -683,12 +1558,14 @@ AppNode::AppNode(Model *model, Node *parent, const QUrl &url, const QString &fil
     QStringList categories = info.value("Categories").toString().split(";", QString::SkipEmptyParts);
     if (!categories.isEmpty())
         m_category = categories.first();
+    //the base ctor only knew the file name
+    updateSortKey();
 }
 
 QIcon
 AppNode::icon() const
 {
-    return QIcon::fromTheme(m_appIcon, FileIconProvider::fileIcon(*this));
+    return QIcon::fromTheme(m_appIcon, Node::icon());
 }
 
 QString
@@ -706,7 +1583,7 @@ AppNode::name() const
 QVariant
 AppNode::data(const int column) const
 {
-    if (exists())
+    if (fileExists())
         switch (column)
         {
         case 0: return m_appName; break;
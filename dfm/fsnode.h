@@ -25,6 +25,15 @@
 #include <QMutex>
 #include <QUrl>
 #include <QIcon>
+#include <QHash>
+#include <QStringList>
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+
+#include "helpers.h"
+#include "fscache.h"
+#include "statbatch.h"
 
 class Data;
 namespace DFM
@@ -44,7 +53,23 @@ public:
     enum Child { Visible = 0, Hidden = 1, Filtered = 2, ChildrenTypeCount = 3 };
     enum Types { File = 0, App, Trash };
     typedef unsigned int Children, Type;
+
+    //what sorting looks at, gathered once so comparing
+    //two nodes never goes back to the disk or the locale
+    struct SortKey
+    {
+        enum Flag { Dir = 1, Hidden = 2 };
+        QByteArray name, suffix; //folded, name collated when natural
+        FileStamp stamp; //size and mtime sort, the whole of it validates Data
+        uint perms;
+        uchar flags;
+        bool natural;
+        bool lazy; //only name and type from the dir entry, ensureStat() does the rest
+    };
+    enum Listed { ListedFile = 0, ListedDir };
     Node(FS::Model *model = 0, const QUrl &url = QUrl(), Node *parent = 0, const QString &filePath = QString(), const Type t = File);
+    Node(FS::Model *model, const QUrl &url, Node *parent, const DirCache::Entry &entry); //from a shared listing
+    Node(FS::Model *model, const QUrl &url, Node *parent, const QString &filePath, const Listed listed); //from a dir entry, not stat'ed
     virtual ~Node();
 
     bool isFiltered(const QString &name);
@@ -52,16 +77,37 @@ public:
     inline Model *model() const { return m_model; }
     Worker::Gatherer *gatherer() const;
 
-    virtual QString name() const { return m_name; }
+    virtual QString name() const { return m_name.isNull()?fileName():m_name; }
     bool rename(const QString &newName);
-    inline QString filePath() const { return m_filePath; }
+    inline QString filePath() const { return QFileInfo::filePath(); }
+    //known without a stat, also for lazy nodes
+    inline bool isDirectory() const { return m_sortKey.flags & SortKey::Dir; }
+    inline bool isHiddenFile() const { return m_sortKey.flags & SortKey::Hidden; }
+    //answered from the sort key and never from the disk, a lazy node has
+    //no size, date or permissions until the gatherer stat'ed it. the
+    //QFileInfo of the node is left to whoever gets handed one.
+    inline bool isLazy() const { return m_sortKey.lazy; }
+    inline bool fileExists() const { return m_sortKey.lazy || !m_sortKey.stamp.isNull(); }
+    inline qint64 fileSize() const { return stamp().size; }
+    inline QDateTime fileModified() const { return QDateTime::fromMSecsSinceEpoch(stamp().msecs()); }
+    inline QFile::Permissions filePermissions() const { return QFile::Permissions(m_sortKey.perms); }
+    inline bool canRead() const { return filePermissions() & QFile::ReadUser; }
+    inline bool canWrite() const { return filePermissions() & QFile::WriteUser; }
+    inline bool canExecute() const { return filePermissions() & QFile::ExeUser; }
+    bool isSymLink() const;
 
     int row() const;
     int rowOf(const Node *node) const;
     int childCount(Children children = Visible) const;
     void addChild(Node *node);
+    void addChildren(const Nodes &nodes);
+    void startBatch();
+    void flushBatch();
+    void endBatch();
+    int batchCount() const;
     Node *child(const int c, Children fromChildren = Visible) const;
     Node *child(const QString &name, const bool nameIsPath = true) const;
+    Nodes children(Children fromChildren = Visible) const;
     Node *childFromUrl(const QUrl &url) const;
     bool hasChildren() const;
     void insertChild(Node *n, const int i);
@@ -69,6 +115,9 @@ public:
 
     void removeDeleted();
     void rePopulate();
+    void insertEntries(const QStringList &names);
+    void removeEntries(const QStringList &names);
+    void updateEntries(const QStringList &names);
     bool isPopulated() const;
 
     virtual QVariant data(const int column) const;
@@ -84,6 +133,16 @@ public:
     virtual void exec();
 
     void sort();
+    inline const SortKey &sortKey() const { return m_sortKey; }
+    void updateSortKey();
+    void updateNameKey();
+    void updateSortKey(const DirCache::Entry &entry);
+    void updateSortKey(const Listed listed);
+    void updateSortKey(const StatBatch::Result &stat);
+    static void ensureStat(const Nodes &nodes);
+    void setStamp(const FileStamp &stamp);
+    inline const FileStamp &stamp() const { return m_sortKey.stamp; }
+    static bool needsStat(const int sortColumn);
     int sortColumn() const;
     Qt::SortOrder sortOrder() const;
 
@@ -93,16 +152,18 @@ public:
     bool showHidden() const;
 
     void setFilter(const QString &filter);
-    inline QString filter() const { return m_filter; }
+    QString filter() const;
 
     void clearVisible();
     void removeChild(Node *node);
+    void evict();
+    inline qint64 lastUsed() const { return m_contents?m_contents->lastUsed:0; }
 
     Node *localNode(const QString &path, bool checkOnly = true);
     Node *nodeFromLocalPath(const QString &path, bool checkOnly = true);
 
-    inline QUrl url() const { return m_url; }
-    inline void setUrl(const QUrl &url) { m_url = url; }
+    inline QUrl url() const { return m_localUrl?QUrl::fromLocalFile(filePath()):m_url; }
+    void setUrl(const QUrl &url);
 
     inline Type type() { return m_type; }
     inline void setType(const Type t) { m_type = t; }
@@ -110,18 +171,46 @@ public:
     Node *parent() const;
     inline Node *operator[] (const int i) { return child(i); }
 
-private:
-    mutable int m_isExe;
-    mutable QMutex m_mutex;
+protected:
+    QUrl childUrl(const QString &file) const;
+    void addIndex(Node *node);
+    void removeIndex(Node *node);
 
-    bool m_isPopulated, m_isDeleted, m_invertFilter;
-    Nodes m_children[ChildrenTypeCount], m_toAdd;
+private:
+    //everything a node needs once it has children, files never get one.
+    //the node itself keeps the path in QFileInfo, m_name only when it
+    //differs from the file name and m_url only when it is not just the
+    //local file url of the path.
+    struct Contents
+    {
+        Contents() : rowsDirty(false), isBatching(false), invertFilter(false), lastUsed(0) {}
+        mutable QMutex mutex;
+        mutable QHash<const Node *, int> rows;
+        mutable bool rowsDirty;
+        bool isBatching, invertFilter;
+        QHash<QString, Node *> pathIndex;
+        QMultiHash<QString, Node *> nameIndex; //search results can share a name
+        QHash<QUrl, Node *> urlIndex; //only children with a non local url
+        Nodes children[ChildrenTypeCount], toAdd;
+        QString filter;
+        qint64 lastUsed; //Model::touch() tick of the last visit
+    };
+    Contents *contents();
+    void init(const QUrl &url, const QString &filePath);
+    bool listFromCache();
+    void listFromDisk();
+    bool listEntries(DirCache::Entries &entries);
+    void releaseCache();
+
+    Contents *m_contents;
     Node *m_parent;
-    QString m_filePath, m_filter, m_name;
-    QUrl m_url;
     Model *m_model;
-    QIcon m_icon;
-    Type m_type;
+    QString m_name;
+    QUrl m_url;
+    mutable SortKey m_sortKey;
+    mutable signed char m_isExe, m_isLink;
+    bool m_isPopulated, m_isDeleted, m_localUrl, m_cacheRef;
+    uchar m_type;
 };
 
 //-----------------------------------------------------------------------------
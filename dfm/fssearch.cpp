@@ -0,0 +1,387 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+#include "fssearch.h"
+#include "config.h"
+
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFile>
+#include <QThread>
+
+#if defined(HASGETDENTS)
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+#define MAXFDS 256 //dir handles allowed to wait in the queues
+
+using namespace DFM;
+using namespace FS;
+using namespace Worker;
+
+Matcher::Matcher(const QString &pattern)
+    : m_mode(Substring)
+    , m_substring(pattern, Qt::CaseInsensitive)
+{
+    if (pattern.size() > 2 && pattern.startsWith(QLatin1Char('/')) && pattern.endsWith(QLatin1Char('/')))
+    {
+        m_mode = RegExp;
+        m_rx = QRegExp(pattern.mid(1, pattern.size()-2), Qt::CaseInsensitive, QRegExp::RegExp2);
+    }
+    else if (pattern.contains(QLatin1Char('*')) || pattern.contains(QLatin1Char('?')) || pattern.contains(QLatin1Char('[')))
+    {
+        m_mode = Glob;
+        m_rx = QRegExp(pattern, Qt::CaseInsensitive, QRegExp::Wildcard);
+    }
+    //a broken expression is just text
+    if (m_mode != Substring && !m_rx.isValid())
+        m_mode = Substring;
+}
+
+bool
+Matcher::matches(const QString &name) const
+{
+    switch (m_mode)
+    {
+    case Glob: return m_rx.exactMatch(name);
+    case RegExp: return m_rx.indexIn(name) != -1;
+    default: return m_substring.indexIn(name) != -1;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+class SearchEngine::Runner : public QRunnable
+{
+public:
+    Runner(SearchEngine *engine, const int id) : m_engine(engine), m_id(id) {}
+    void run() { m_engine->work(m_id); }
+
+private:
+    SearchEngine *m_engine;
+    int m_id;
+};
+
+SearchEngine::SearchEngine(const QString &root, const QString &pattern, const bool showHidden)
+    : m_root(root)
+    , m_pattern(pattern)
+    , m_showHidden(showHidden)
+    , m_otherFs(Store::config.behaviour.searchOtherFs)
+    , m_canceled(false)
+    , m_done(false)
+    , m_rootDev(0)
+    , m_pending(0)
+    , m_running(0)
+    , m_openFds(0)
+{
+    const QStringList &excludes = Store::config.behaviour.searchExcludes;
+    for (int i = 0; i < excludes.count(); ++i)
+    {
+        const QString &exclude = excludes.at(i).trimmed();
+        if (!exclude.isEmpty())
+            m_excludes.insert(exclude);
+    }
+    //mostly waiting on the disk, a few more threads than cores dont hurt
+    m_pool.setMaxThreadCount(qBound(2, QThread::idealThreadCount()*2, 16));
+    for (int i = 0; i < m_pool.maxThreadCount(); ++i)
+        m_deques << new Deque();
+}
+
+SearchEngine::~SearchEngine()
+{
+    cancel();
+    m_pool.waitForDone();
+    for (int i = 0; i < m_deques.count(); ++i)
+    {
+#if defined(HASGETDENTS)
+        const QList<Dir> &dirs = m_deques.at(i)->dirs;
+        for (int d = 0; d < dirs.count(); ++d)
+            if (dirs.at(d).fd != -1)
+                close(dirs.at(d).fd);
+#endif
+        delete m_deques.at(i);
+    }
+}
+
+void
+SearchEngine::start()
+{
+#if defined(HASGETDENTS)
+    struct stat st;
+    if (!stat(QFile::encodeName(m_root).constData(), &st))
+        m_rootDev = st.st_dev;
+#endif
+    Dir root;
+    root.path = m_root;
+    root.fd = -1;
+    push(0, root);
+    m_hitsMutex.lock();
+    m_running = m_deques.count();
+    m_hitsMutex.unlock();
+    for (int i = 0; i < m_deques.count(); ++i)
+        m_pool.start(new Runner(this, i));
+}
+
+void
+SearchEngine::cancel()
+{
+    m_workMutex.lock();
+    m_canceled = true;
+    m_workMutex.unlock();
+    m_workCond.wakeAll();
+    m_hitsCond.wakeAll();
+}
+
+bool
+SearchEngine::isCanceled() const
+{
+    QMutexLocker locker(&m_workMutex);
+    return m_canceled;
+}
+
+bool
+SearchEngine::takeHits(QStringList &hits, const int msecs)
+{
+    QMutexLocker locker(&m_hitsMutex);
+    if (m_hits.isEmpty() && !m_done)
+        m_hitsCond.wait(&m_hitsMutex, msecs);
+    hits = m_hits;
+    m_hits.clear();
+    return !(hits.isEmpty() && m_done);
+}
+
+bool
+SearchEngine::isExcluded(const QString &name) const
+{
+    return !m_excludes.isEmpty() && m_excludes.contains(name);
+}
+
+void
+SearchEngine::push(const int id, const Dir &dir)
+{
+    //counted before it is visible so pending never hits 0 while work is around
+    m_workMutex.lock();
+    ++m_pending;
+    m_workMutex.unlock();
+    Deque *deque = m_deques.at(id);
+    deque->mutex.lock();
+    deque->dirs << dir;
+    deque->mutex.unlock();
+    m_workCond.wakeOne();
+}
+
+bool
+SearchEngine::next(const int id, Dir &dir)
+{
+    const int n = m_deques.count();
+    forever
+    {
+        //newest of our own first to stay deep in one subtree,
+        //oldest of the others as those are the biggest chunks
+        for (int i = 0; i < n; ++i)
+        {
+            Deque *deque = m_deques.at((id+i)%n);
+            QMutexLocker locker(&deque->mutex);
+            if (deque->dirs.isEmpty())
+                continue;
+            dir = i ? deque->dirs.takeFirst() : deque->dirs.takeLast();
+            return true;
+        }
+        QMutexLocker locker(&m_workMutex);
+        if (!m_pending || m_canceled)
+            return false;
+        //short timeout, a wake can slip in between the scan above and here
+        m_workCond.wait(&m_workMutex, 5);
+    }
+}
+
+void
+SearchEngine::dirDone()
+{
+    QMutexLocker locker(&m_workMutex);
+    if (!--m_pending)
+        m_workCond.wakeAll();
+}
+
+void
+SearchEngine::post(QStringList &hits)
+{
+    if (hits.isEmpty())
+        return;
+    QMutexLocker locker(&m_hitsMutex);
+    m_hits += hits;
+    hits.clear();
+    m_hitsCond.wakeAll();
+}
+
+void
+SearchEngine::work(const int id)
+{
+    const Matcher matcher(m_pattern);
+    QStringList hits;
+    Dir dir;
+    while (next(id, dir))
+    {
+        scan(id, dir, matcher, hits);
+        post(hits);
+        dirDone();
+    }
+    QMutexLocker locker(&m_hitsMutex);
+    if (!--m_running)
+        m_done = true;
+    m_hitsCond.wakeAll();
+}
+
+void
+SearchEngine::scan(const int id, const Dir &dir, const Matcher &matcher, QStringList &hits)
+{
+#if defined(HASGETDENTS)
+    int fd = dir.fd;
+    if (fd != -1)
+        dropFd();
+    else
+        fd = open(QFile::encodeName(dir.path).constData(), O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if (fd != -1)
+    {
+        if (!isCanceled())
+            scan(id, fd, dir.path, matcher, hits);
+        close(fd);
+        return;
+    }
+#endif
+    if (isCanceled())
+        return;
+    //no way to see the device here, other filesystems are searched too
+    QDir::Filters filters = QDir::AllEntries|QDir::NoDotAndDotDot|QDir::System;
+    if (m_showHidden)
+        filters |= QDir::Hidden;
+    QDirIterator it(dir.path, filters);
+    while (it.hasNext())
+    {
+        const QString &file = it.next();
+        const QFileInfo &fi = it.fileInfo();
+        const QString &name = it.fileName();
+        if (matcher.matches(name))
+            hits << file;
+        if (fi.isDir() && !fi.isSymLink() && !isExcluded(name))
+        {
+            Dir sub;
+            sub.path = file;
+            sub.fd = -1;
+            push(id, sub);
+        }
+    }
+}
+
+#if defined(HASGETDENTS)
+
+//what getdents64 hands us, glibc doesnt export it everywhere
+struct LinuxDirent64
+{
+    quint64 ino;
+    qint64 off;
+    unsigned short reclen;
+    unsigned char type;
+    char name[1];
+};
+
+bool
+SearchEngine::holdFd()
+{
+    QMutexLocker locker(&m_workMutex);
+    if (m_openFds >= MAXFDS)
+        return false;
+    ++m_openFds;
+    return true;
+}
+
+void
+SearchEngine::dropFd()
+{
+    QMutexLocker locker(&m_workMutex);
+    --m_openFds;
+}
+
+void
+SearchEngine::scan(const int id, const int fd, const QString &path, const Matcher &matcher, QStringList &hits)
+{
+    const QString &prefix = path.endsWith(QLatin1Char('/')) ? path : path + QLatin1Char('/');
+    quint64 buf[2048]; //16k, aligned for the dirents
+    forever
+    {
+        const long n = syscall(SYS_getdents64, fd, buf, sizeof buf);
+        if (n <= 0)
+            break;
+        for (long pos = 0; pos < n;)
+        {
+            const LinuxDirent64 *d = reinterpret_cast<const LinuxDirent64 *>(reinterpret_cast<const char *>(buf)+pos);
+            pos += d->reclen;
+            const char *name = d->name;
+            if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+                continue;
+            if (name[0] == '.' && !m_showHidden)
+                continue;
+            const QString &fileName = QFile::decodeName(name);
+            if (matcher.matches(fileName))
+                hits << prefix + fileName;
+
+            //links are not followed, same as QDirIterator without FollowSymlinks
+            unsigned char type = d->type;
+            struct stat st;
+            bool statted = false;
+            if (type == DT_UNKNOWN)
+            {
+                if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW))
+                    continue;
+                statted = true;
+                type = S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+            }
+            if (type != DT_DIR || isExcluded(fileName))
+                continue;
+            if (!m_otherFs)
+            {
+                if (!statted && fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW))
+                    continue;
+                if ((quint64)st.st_dev != m_rootDev)
+                    continue;
+            }
+            Dir sub;
+            sub.path = prefix + fileName;
+            sub.fd = -1;
+            //keep the handle while we have it, saves a path lookup later
+            if (holdFd())
+            {
+                sub.fd = openat(fd, name, O_RDONLY|O_DIRECTORY|O_CLOEXEC|O_NOFOLLOW);
+                if (sub.fd == -1)
+                    dropFd();
+            }
+            push(id, sub);
+        }
+        if (isCanceled())
+            return;
+    }
+}
+
+#endif
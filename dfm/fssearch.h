@@ -0,0 +1,123 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+#ifndef FSSEARCH_H
+#define FSSEARCH_H
+
+#include <QRunnable>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringMatcher>
+#include <QStringList>
+#include <QRegExp>
+#include <QVector>
+#include <QSet>
+
+namespace DFM
+{
+namespace FS
+{
+namespace Worker
+{
+
+/* Decides once how a search string is matched:
+ * '/expr/' is a regular expression, anything with
+ * '*', '?' or '[' is a glob over the whole name and
+ * the rest is a case insensitive substring.
+ * QRegExp keeps its captures per instance so every
+ * thread needs its own copy.
+ */
+
+class Matcher
+{
+public:
+    enum Mode { Substring = 0, Glob, RegExp };
+    explicit Matcher(const QString &pattern = QString());
+    bool matches(const QString &name) const;
+    inline Mode mode() const { return m_mode; }
+
+private:
+    Mode m_mode;
+    QStringMatcher m_substring;
+    QRegExp m_rx;
+};
+
+/* Walks a tree with a pool of workers. Each worker
+ * owns a deque of directories, it takes from the back
+ * of its own and steals from the front of the others
+ * when it runs dry. Hits are handed out in batches
+ * through takeHits().
+ */
+
+class SearchEngine
+{
+public:
+    SearchEngine(const QString &root, const QString &pattern, const bool showHidden);
+    ~SearchEngine();
+    void start();
+    void cancel();
+    bool isCanceled() const;
+    //waits at most msecs for hits, false when all is searched and taken
+    bool takeHits(QStringList &hits, const int msecs = 100);
+
+protected:
+    struct Dir
+    {
+        QString path;
+        int fd; //-1 when only the path is known
+    };
+    class Runner;
+    void work(const int id);
+    void push(const int id, const Dir &dir);
+    bool next(const int id, Dir &dir);
+    void dirDone();
+    void scan(const int id, const Dir &dir, const Matcher &matcher, QStringList &hits);
+#if defined(HASGETDENTS)
+    void scan(const int id, const int fd, const QString &path, const Matcher &matcher, QStringList &hits);
+    bool holdFd();
+    void dropFd();
+#endif
+    void post(QStringList &hits);
+    bool isExcluded(const QString &name) const;
+
+private:
+    struct Deque
+    {
+        QList<Dir> dirs;
+        QMutex mutex;
+    };
+    QString m_root, m_pattern;
+    bool m_showHidden, m_otherFs, m_canceled, m_done;
+    quint64 m_rootDev;
+    QSet<QString> m_excludes;
+    QVector<Deque *> m_deques;
+    QThreadPool m_pool;
+    int m_pending, m_running, m_openFds;
+    mutable QMutex m_workMutex, m_hitsMutex;
+    QWaitCondition m_workCond, m_hitsCond;
+    QStringList m_hits;
+};
+
+} //namespace Worker
+} //namespace FS
+}
+
+#endif // FSSEARCH_H
@@ -0,0 +1,341 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+#include <QFile>
+#include <QTimer>
+#include <QSocketNotifier>
+#include <QFileSystemWatcher>
+
+#include "fswatcher.h"
+
+#if defined(HASINOTIFY)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+using namespace DFM;
+using namespace FS;
+
+#if defined(HASINOTIFY)
+#define WATCHMASK (IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_ATTRIB|IN_MODIFY|IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR)
+#define COALESCE 50 //ms we collect events before handing them out
+#endif
+
+WatchHub *WatchHub::s_instance = 0;
+
+WatchHub
+*WatchHub::instance()
+{
+    if (!s_instance)
+        s_instance = new WatchHub();
+    return s_instance;
+}
+
+WatchHub::WatchHub(QObject *parent)
+    : QObject(parent)
+#if defined(HASINOTIFY)
+    , m_fd(inotify_init())
+    , m_overflow(false)
+    , m_notifier(0)
+    , m_timer(new QTimer(this))
+#else
+    , m_watcher(new QFileSystemWatcher(this))
+#endif
+{
+#if defined(HASINOTIFY)
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(COALESCE);
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(flushEvents()));
+    if (m_fd != -1)
+    {
+        fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+        fcntl(m_fd, F_SETFD, FD_CLOEXEC);
+        m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+        connect(m_notifier, SIGNAL(activated(int)), this, SLOT(readEvents()));
+    }
+#else
+    connect(m_watcher, SIGNAL(directoryChanged(QString)), this, SLOT(fallbackChanged(QString)));
+#endif
+}
+
+WatchHub::~WatchHub()
+{
+#if defined(HASINOTIFY)
+    if (m_fd != -1)
+        close(m_fd);
+#endif
+}
+
+void
+WatchHub::ref(const QString &path)
+{
+    ++m_refs[path];
+#if defined(HASINOTIFY)
+    if (m_fd == -1 || m_wds.contains(path))
+        return;
+    const int wd = inotify_add_watch(m_fd, QFile::encodeName(path).constData(), WATCHMASK);
+    if (wd == -1)
+        return;
+    m_dirs.insert(wd, path);
+    m_wds.insert(path, wd);
+    emit watchAdded(path);
+#else
+    if (m_refs.value(path) != 1)
+        return;
+    m_watcher->addPath(path);
+    if (m_watcher->directories().contains(path))
+        emit watchAdded(path);
+#endif
+}
+
+void
+WatchHub::deref(const QString &path)
+{
+    QHash<QString, int>::iterator it = m_refs.find(path);
+    if (it == m_refs.end() || --it.value())
+        return;
+    m_refs.erase(it);
+#if defined(HASINOTIFY)
+    if (!m_wds.contains(path))
+        return;
+    const int wd = m_wds.take(path);
+    if (m_dirs.value(wd) == path)
+    {
+        m_dirs.remove(wd);
+        inotify_rm_watch(m_fd, wd);
+    }
+    m_pending.remove(path);
+    emit watchRemoved(path);
+#else
+    m_watcher->removePath(path);
+    emit watchRemoved(path);
+#endif
+}
+
+QStringList
+WatchHub::directories() const
+{
+#if defined(HASINOTIFY)
+    return m_wds.keys();
+#else
+    return m_watcher->directories();
+#endif
+}
+
+void
+WatchHub::readEvents()
+{
+#if defined(HASINOTIFY)
+    char buf[16384] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(m_fd, buf, sizeof buf)) > 0)
+    {
+        for (char *p = buf; p < buf+len; )
+        {
+            const struct inotify_event *ev = reinterpret_cast<const struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                m_overflow = true;
+                continue;
+            }
+            const QString &dir = m_dirs.value(ev->wd);
+            if (dir.isEmpty())
+                continue;
+            if (ev->mask & (IN_DELETE_SELF|IN_MOVE_SELF|IN_IGNORED))
+            {
+                //the kernel drops the watch of a deleted or unmounted
+                //dir, a moved one keeps it so we have to let it go.
+                if (ev->mask & IN_MOVE_SELF)
+                    inotify_rm_watch(m_fd, ev->wd);
+                if (!m_gone.contains(dir))
+                    m_gone << dir;
+                continue;
+            }
+            if (!ev->len)
+                continue;
+            const QString &name = QFile::decodeName(ev->name);
+            if (ev->mask & (IN_CREATE|IN_MOVED_TO))
+                queueEvent(dir, name, Added);
+            else if (ev->mask & (IN_DELETE|IN_MOVED_FROM))
+                queueEvent(dir, name, Removed);
+            else if (ev->mask & (IN_ATTRIB|IN_MODIFY))
+                queueEvent(dir, name, Changed);
+        }
+    }
+    if (!m_timer->isActive())
+        m_timer->start();
+#endif
+}
+
+#if defined(HASINOTIFY)
+void
+WatchHub::queueEvent(const QString &path, const QString &name, const Change change)
+{
+    QHash<QString, Change> &dir = m_pending[path];
+    if (!dir.contains(name))
+    {
+        dir.insert(name, change);
+        return;
+    }
+    const Change prev = dir.value(name);
+    switch (change)
+    {
+    case Added: dir.insert(name, prev == Removed ? Changed : Added); break; //removed and recreated == replaced
+    case Removed: dir.insert(name, Removed); break;
+    case Changed: if (prev == Removed) dir.insert(name, Changed); break; //added stays added
+    default: break;
+    }
+}
+#endif
+
+void
+WatchHub::flushEvents()
+{
+#if defined(HASINOTIFY)
+    //listeners might add or remove watches while
+    //we emit so we work on copies...
+    const QStringList gone(m_gone);
+    const QMap<QString, QHash<QString, Change> > pending(m_pending);
+    m_gone.clear();
+    m_pending.clear();
+
+    for (int i = 0; i < gone.count(); ++i)
+    {
+        const QString &path = gone.at(i);
+        if (m_wds.contains(path))
+            m_dirs.remove(m_wds.take(path));
+        //the watch is dead, whoever wants it back adds it again
+        m_refs.remove(path);
+        emit watchLost(path);
+    }
+
+    if (m_overflow)
+    {
+        //events were lost, we cant know what
+        //happened so everything gets rescanned.
+        m_overflow = false;
+        const QStringList &dirs = directories();
+        for (int i = 0; i < dirs.count(); ++i)
+            emit directoryChanged(dirs.at(i));
+        return;
+    }
+
+    for (QMap<QString, QHash<QString, Change> >::const_iterator d = pending.constBegin(), de = pending.constEnd(); d!=de; ++d)
+    {
+        if (gone.contains(d.key()))
+            continue;
+        QStringList added, removed, changed;
+        for (QHash<QString, Change>::const_iterator b = d.value().constBegin(), e = d.value().constEnd(); b!=e; ++b)
+            switch (b.value())
+            {
+            case Added: added << b.key(); break;
+            case Removed: removed << b.key(); break;
+            case Changed: changed << b.key(); break;
+            default: break;
+            }
+        emit entriesChanged(d.key(), added, removed, changed);
+    }
+#endif
+}
+
+void
+WatchHub::fallbackChanged(const QString &path)
+{
+#if !defined(HASINOTIFY)
+    if (!m_watcher->directories().contains(path))
+    {
+        m_refs.remove(path);
+        emit watchLost(path);
+        return;
+    }
+    emit directoryChanged(path);
+#else
+    Q_UNUSED(path);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+
+Watcher::Watcher(QObject *parent)
+    : QObject(parent)
+{
+    WatchHub *hub = WatchHub::instance();
+    connect(hub, SIGNAL(watchLost(QString)), this, SLOT(hubWatchLost(QString)));
+    connect(hub, SIGNAL(directoryChanged(QString)), this, SLOT(hubDirectoryChanged(QString)));
+    connect(hub, SIGNAL(entriesChanged(QString,QStringList,QStringList,QStringList)), this, SLOT(hubEntriesChanged(QString,QStringList,QStringList,QStringList)));
+}
+
+Watcher::~Watcher()
+{
+    removePaths(directories());
+}
+
+void
+Watcher::addPath(const QString &path)
+{
+    if (m_paths.contains(path))
+        return;
+    m_paths.insert(path);
+    WatchHub::instance()->ref(path);
+}
+
+void
+Watcher::removePath(const QString &path)
+{
+    if (m_paths.remove(path))
+        WatchHub::instance()->deref(path);
+}
+
+void
+Watcher::removePaths(const QStringList &paths)
+{
+    for (int i = 0; i < paths.count(); ++i)
+        removePath(paths.at(i));
+}
+
+QStringList
+Watcher::directories() const
+{
+    return m_paths.toList();
+}
+
+void
+Watcher::hubWatchLost(const QString &path)
+{
+    //the hub already forgot about it, no deref
+    if (m_paths.remove(path))
+        emit directoryRemoved(path);
+}
+
+void
+Watcher::hubDirectoryChanged(const QString &path)
+{
+    if (m_paths.contains(path))
+        emit directoryChanged(path);
+}
+
+void
+Watcher::hubEntriesChanged(const QString &path, const QStringList &added, const QStringList &removed, const QStringList &changed)
+{
+    if (m_paths.contains(path))
+        emit entriesChanged(path, added, removed, changed);
+}
@@ -0,0 +1,130 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+
+#ifndef FSWATCHER_H
+#define FSWATCHER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+
+class QSocketNotifier;
+class QTimer;
+class QFileSystemWatcher;
+
+namespace DFM
+{
+namespace FS
+{
+
+/* Directory watcher that, unlike QFileSystemWatcher,
+ * tells what changed in a directory. On linux inotify
+ * events are collected for a short while and handed out
+ * per directory as added/removed/changed entry names,
+ * directoryChanged() is only emitted when a watched
+ * directory itself goes away or when the kernel queue
+ * overflowed and a full rescan is needed.
+ *
+ * There is one WatchHub per process holding the actual
+ * watches, counted per path, and every model gets a
+ * Watcher that only hears about the paths it added.
+ * Tabs showing the same directory share one watch.
+ */
+
+class WatchHub : public QObject
+{
+    Q_OBJECT
+public:
+    enum Change { Added = 0, Removed, Changed };
+    static WatchHub *instance();
+    ~WatchHub();
+
+    void ref(const QString &path);
+    void deref(const QString &path);
+    QStringList directories() const;
+
+signals:
+    void directoryChanged(const QString &path);
+    void entriesChanged(const QString &path, const QStringList &added, const QStringList &removed, const QStringList &changed);
+    void watchLost(const QString &path); //the dir itself went away
+    void watchAdded(const QString &path); //first ref, the watch is in place
+    void watchRemoved(const QString &path); //last deref
+
+protected:
+    explicit WatchHub(QObject *parent = 0);
+
+private slots:
+    void readEvents();
+    void flushEvents();
+    void fallbackChanged(const QString &path);
+
+private:
+    static WatchHub *s_instance;
+    QHash<QString, int> m_refs;
+#if defined(HASINOTIFY)
+    void queueEvent(const QString &path, const QString &name, const Change change);
+    int m_fd;
+    bool m_overflow;
+    QSocketNotifier *m_notifier;
+    QTimer *m_timer;
+    QHash<int, QString> m_dirs;
+    QHash<QString, int> m_wds;
+    QMap<QString, QHash<QString, Change> > m_pending;
+    QStringList m_gone;
+#else
+    QFileSystemWatcher *m_watcher;
+#endif
+};
+
+class Watcher : public QObject
+{
+    Q_OBJECT
+public:
+    typedef WatchHub::Change Change;
+    explicit Watcher(QObject *parent = 0);
+    ~Watcher();
+
+    void addPath(const QString &path);
+    void removePath(const QString &path);
+    void removePaths(const QStringList &paths);
+    QStringList directories() const;
+
+signals:
+    void directoryChanged(const QString &path);
+    void directoryRemoved(const QString &path); //deleted or moved away
+    void entriesChanged(const QString &path, const QStringList &added, const QStringList &removed, const QStringList &changed);
+
+private slots:
+    void hubWatchLost(const QString &path);
+    void hubDirectoryChanged(const QString &path);
+    void hubEntriesChanged(const QString &path, const QStringList &added, const QStringList &removed, const QStringList &changed);
+
+private:
+    QSet<QString> m_paths;
+};
+
+}
+
+}
+
+#endif // FSWATCHER_H
@@ -26,112 +26,514 @@
 #include "fsnode.h"
 #include "helpers.h"
 #include "devices.h"
+#include "fssearch.h"
 
 using namespace DFM;
 using namespace FS;
 using namespace Worker;
 
+#define MAXRUNNERS 4
+#define MAXPREFETCHRUNNERS 1 //prefetch is light on io and never takes the foreground's runners
+#define MAXPREFETCHQUEUE 8
+#define PREFETCHDATA 32 //rows we load mimes and icons for ahead of time
+#define IDLETIMEOUT 10000 //ms a runner waits for work before it goes
+
+static bool
+isAncestorPath(const QString &dir, const QString &path)
+{
+    if (dir.isEmpty())
+        return false;
+    return path == dir || path.startsWith(dir.endsWith("/") ? dir : dir + "/");
+}
+
+//the tree, not the paths, scheme nodes have none
+static bool
+isAncestor(const Node *node, const Node *of)
+{
+    for (const Node *n = of; n; n = n->parent())
+        if (n == node)
+            return true;
+    return false;
+}
+
+//rePopulate() walks down into every populated child, a sort
+//into every shown one and an update writes the entries it got
+static inline bool
+walksDown(const Task task)
+{
+    return task == Populate || task == Sort || task == Update;
+}
+
+//two jobs that would write to the same nodes
+static bool
+conflicts(const Job &a, const Job &b)
+{
+    if (a.m_node == b.m_node)
+        return true;
+    if (a.m_task == Generate && walksDown(b.m_task))
+        return isAncestorPath(b.m_node->filePath(), a.m_path) || isAncestor(b.m_node, a.m_node);
+    if (b.m_task == Generate && walksDown(a.m_task))
+        return isAncestorPath(a.m_node->filePath(), b.m_path) || isAncestor(a.m_node, b.m_node);
+    if (walksDown(a.m_task) && walksDown(b.m_task))
+        return isAncestor(a.m_node, b.m_node) || isAncestor(b.m_node, a.m_node);
+    return false;
+}
+
+Runner::Runner(Gatherer *gatherer)
+    : QThread(gatherer)
+    , m_gatherer(gatherer)
+{
+}
+
+void
+Runner::run()
+{
+    Job job;
+    while (m_gatherer->takeJob(this, job))
+    {
+        m_gatherer->runJob(job);
+        m_gatherer->finishJob(this);
+    }
+    //the last one of us out might delete the model, nothing after this
+    m_gatherer->m_model->deref();
+}
+
+//-----------------------------------------------------------------------------
+
 Gatherer::Gatherer(QObject *parent)
-    :DThread(parent)
-    , m_node(0)
+    : QObject(parent)
     , m_model(static_cast<FS::Model *>(parent))
-    , m_isCancelled(false)
+    , m_working(false)
+    , m_quit(false)
+{
+    connect(this, SIGNAL(startedWorking()), m_model, SIGNAL(startedWorking()));
+    connect(this, SIGNAL(finishedWorking()), m_model, SIGNAL(finishedWorking()));
+    connect(this, SIGNAL(jobFinished()), this, SLOT(checkWorking()), Qt::QueuedConnection);
+}
+
+Gatherer::~Gatherer()
+{
+    shutdown();
+}
+
+//from ~Model, the model is only deleted once every runner let go of
+//it so the ones we wait on here are already on their way out
+void
+Gatherer::shutdown()
+{
+    m_mutex.lock();
+    m_quit = true;
+    m_queue.clear();
+    QList<Runner *> runners(m_runners);
+    for (int i = 0; i < m_abandoned.count(); ++i)
+        if (m_abandoned.at(i))
+            runners << m_abandoned.at(i);
+    for (int i = 0; i < runners.count(); ++i)
+        runners.at(i)->m_job.cancel();
+    m_jobCond.wakeAll();
+    m_mutex.unlock();
+    for (int i = 0; i < runners.count(); ++i)
+        runners.at(i)->wait();
+}
+
+bool
+Gatherer::isCancelled() const
+{
+    //asked from inside a job, so the job of the calling thread
+    if (Runner *runner = dynamic_cast<Runner *>(QThread::currentThread()))
+        return runner->isCancelled();
+    return false;
+}
+
+bool
+Gatherer::isWorking() const
+{
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i < m_queue.count(); ++i)
+        if (m_queue.at(i).m_priority > Prefetch)
+            return true;
+    for (int i = 0; i < m_runners.count(); ++i)
+        if (m_runners.at(i)->m_job.m_task != NoTask && m_runners.at(i)->m_job.m_priority > Prefetch)
+            return true;
+    return false;
+}
+
+bool
+Gatherer::isIdle() const
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_queue.isEmpty())
+        return false;
+    for (int i = 0; i < m_runners.count(); ++i)
+        if (m_runners.at(i)->m_job.m_task != NoTask)
+            return false;
+    for (int i = 0; i < m_abandoned.count(); ++i)
+        if (m_abandoned.at(i)) //might still wake up and write to the tree
+            return false;
+    return true;
+}
+
+void
+Gatherer::checkWorking()
+{
+    const bool working = isWorking();
+    if (working == m_working)
+        return;
+    m_working = working;
+    if (working)
+        emit startedWorking();
+    else
+        emit finishedWorking();
+}
+
+void
+Gatherer::enqueue(Job job)
+{
+    m_mutex.lock();
+    if (m_quit)
+    {
+        m_mutex.unlock();
+        return;
+    }
+    //a new current job means the user moved on,
+    //whatever was current before is not wanted anymore
+    if (job.m_priority == Current)
+    {
+        for (int i = m_queue.count()-1; i > -1; --i)
+            if (m_queue.at(i).m_priority == Current && !(m_queue.at(i) == job))
+                m_queue.removeAt(i);
+        for (int i = 0; i < m_runners.count(); ++i)
+            if (m_runners.at(i)->m_job.m_priority == Current && !(m_runners.at(i)->m_job == job))
+                m_runners.at(i)->m_job.cancel();
+    }
+    //the same job running might have looked already, this one
+    //waits behind it as the node conflicts with itself
+    for (int i = 0; i < m_runners.count(); ++i)
+    {
+        Job &running = m_runners.at(i)->m_job;
+        if (running.m_task == NoTask || running.isCancelled())
+            continue;
+        //prefetching yields to anything in its way
+        if (running.m_priority == Prefetch && job.m_priority > Prefetch && conflicts(running, job))
+            running.cancel();
+    }
+    for (int i = 0; i < m_queue.count(); ++i)
+        if (m_queue.at(i) == job)
+        {
+            const Job &queued = m_queue.at(i);
+            job.m_priority = qMax(job.m_priority, queued.m_priority);
+            if (job.m_task == Update) //one pass over everything the watcher saw
+            {
+                job.m_added = queued.m_added + job.m_added;
+                job.m_removed = queued.m_removed + job.m_removed;
+                job.m_changed = queued.m_changed + job.m_changed;
+                job.m_added.removeDuplicates();
+                job.m_removed.removeDuplicates();
+                job.m_changed.removeDuplicates();
+            }
+            m_queue.removeAt(i);
+            break;
+        }
+    //prefetches are lifo, the latest guess is the best one
+    int i = 0;
+    if (job.m_priority == Prefetch)
+        while (i < m_queue.count() && m_queue.at(i).m_priority > Prefetch)
+            ++i;
+    else
+        while (i < m_queue.count() && m_queue.at(i).m_priority >= job.m_priority)
+            ++i;
+    m_queue.insert(i, job);
+    int prefetches = 0;
+    for (int j = 0; j < m_queue.count(); ++j)
+        if (m_queue.at(j).m_priority == Prefetch && ++prefetches > MAXPREFETCHQUEUE)
+            m_queue.removeAt(j--);
+    spawnRunners();
+    m_jobCond.wakeAll();
+    m_mutex.unlock();
+    checkWorking();
+}
+
+//called locked
+void
+Gatherer::spawnRunners()
+{
+    int idle = 0;
+    for (int i = 0; i < m_runners.count(); ++i)
+        if (m_runners.at(i)->m_job.m_task == NoTask)
+            ++idle;
+    while (idle < m_queue.count() && m_runners.count() < MAXRUNNERS)
+    {
+        m_model->ref(); //let go of when the runner returns
+        Runner *runner = new Runner(this);
+        m_runners << runner;
+        runner->start();
+        ++idle;
+    }
+}
+
+//called locked
+bool
+Gatherer::isBlocked(const Job &job) const
+{
+    for (int i = 0; i < m_runners.count(); ++i)
+    {
+        const Job &running = m_runners.at(i)->m_job;
+        if (running.m_task != NoTask && conflicts(running, job))
+            return true;
+    }
+    //an abandoned runner still holds its nodes until it returns
+    for (int i = 0; i < m_abandoned.count(); ++i)
+    {
+        const Runner *runner = m_abandoned.at(i);
+        if (runner && runner->m_job.m_task != NoTask && conflicts(runner->m_job, job))
+            return true;
+    }
+    return false;
+}
+
+bool
+Gatherer::takeJob(Runner *runner, Job &job)
 {
-    connect(this, SIGNAL(started()), m_model, SIGNAL(startedWorking()));
-    connect(this, SIGNAL(finished()), m_model, SIGNAL(finishedWorking()));
+    QMutexLocker locker(&m_mutex);
+    while (!m_quit && m_runners.contains(runner))
+    {
+        int prefetching = 0;
+        for (int i = 0; i < m_runners.count(); ++i)
+            if (m_runners.at(i)->m_job.m_task != NoTask && m_runners.at(i)->m_job.m_priority == Prefetch)
+                ++prefetching;
+        for (int i = 0; i < m_queue.count(); ++i)
+        {
+            const Job &queued = m_queue.at(i);
+            if (queued.m_priority == Prefetch && prefetching >= MAXPREFETCHRUNNERS)
+                break; //only prefetches from here on
+            if (!isBlocked(queued))
+            {
+                //the runner works on a copy, the priority
+                //of m_job can be raised while it runs
+                job = runner->m_job = m_queue.takeAt(i);
+                return true;
+            }
+        }
+        if (!m_jobCond.wait(&m_mutex, IDLETIMEOUT) && m_queue.isEmpty())
+        {
+            //a tab left alone doesnt keep its threads, the next job spawns new ones
+            m_runners.removeAll(runner);
+            m_abandoned << runner;
+            connect(runner, SIGNAL(finished()), runner, SLOT(deleteLater()));
+            return false;
+        }
+    }
+    return false;
 }
 
 void
-Gatherer::setCancelled(bool cancel)
+Gatherer::finishJob(Runner *runner)
 {
-    m_pausingMutex.lock();
-    m_isCancelled=cancel;
-    m_pausingMutex.unlock();
+    m_mutex.lock();
+    runner->m_job = Job();
+    m_abandoned.removeAll(runner); //done writing, nothing left to wait for
+    m_jobCond.wakeAll();
+    m_mutex.unlock();
+    emit jobFinished();
 }
 
 void
-Gatherer::run()
+Gatherer::runJob(const Job &job)
 {
-    switch (m_task)
+    if (job.isCancelled())
+        return;
+    switch (job.m_task)
+    {
+    case Populate:
     {
-    case Populate: if (m_node) m_node->rePopulate(); break;
+        job.m_node->rePopulate();
+        if (job.m_priority == Prefetch)
+            prefetchData(job.m_node, job);
+        break;
+    }
     case Generate:
     {
-        if (QFileInfo(m_path).isDir())
-            m_result = m_node->localNode(m_path, false);
-        if (m_result)
-            emit nodeGenerated(m_path, m_result);
+        //a null result tells the model the path is not there
+        Node *node = job.m_node->localNode(job.m_path, false);
+        if (job.isCancelled())
+            break;
+        emit nodeGenerated(job.m_path, node);
+        if (job.m_priority == Prefetch && node && node->isDirectory() && !node->isPopulated())
+        {
+            node->rePopulate();
+            prefetchData(node, job);
+        }
+        break;
+    }
+    case Search: searchResultsForNode(job.m_name, job.m_path, job.m_node); break;
+    case GetApps: getApplications(job.m_path, job.m_node); break;
+    case Sort: statForSort(job.m_node, job); break;
+    case Update:
+    {
+        //every one of these stats what it got, the order only saves work
+        job.m_node->removeEntries(job.m_removed);
+        job.m_node->updateEntries(job.m_changed);
+        job.m_node->insertEntries(job.m_added);
         break;
     }
-    case Search: searchResultsForNode(m_searchName, m_searchPath, m_node); break;
-    case GetApps: getApplications(m_appsPath, m_node); break;
     default: break;
     }
-    m_taskMutex.lock();
-    m_node = 0;
-    m_task = NoTask;
-    m_taskMutex.unlock();
 }
 
+//the gui sorts on what the nodes have, lazy ones only know
+//their name and type. stat those and let the gui sort again.
 void
-Gatherer::search(const QString &name, const QString &path, Node *node)
+Gatherer::statForSort(Node *node, const Job &job)
+{
+    Nodes lazy, dirs;
+    dirs << node;
+    while (!dirs.isEmpty() && !job.isCancelled())
+    {
+        const Nodes &children = dirs.takeFirst()->children();
+        for (int i = 0; i < children.count(); ++i)
+        {
+            Node *child = children.at(i);
+            if (child->sortKey().lazy)
+                lazy << child;
+            if (child->childCount())
+                dirs << child;
+        }
+    }
+    if (lazy.isEmpty() || job.isCancelled())
+        return;
+    Node::ensureStat(lazy);
+    if (!job.isCancelled())
+        QMetaObject::invokeMethod(m_model, "sortNode", Qt::QueuedConnection);
+}
+
+//the first rows are what shows up when the dir is
+//entered, get their mimes and icons queued already
+void
+Gatherer::prefetchData(Node *node, const Job &job)
+{
+    const int count = qMin(node->childCount(), PREFETCHDATA);
+    for (int i = 0; i < count && !job.isCancelled(); ++i)
+        if (Node *child = node->child(i))
+            DDataLoader::data(child->filePath());
+}
+
+void
+Gatherer::cancel(const Task task)
+{
+    QMutexLocker locker(&m_mutex);
+    for (int i = m_queue.count()-1; i > -1; --i)
+        if (m_queue.at(i).m_task == task)
+            m_queue.removeAt(i);
+    for (int i = 0; i < m_runners.count(); ++i)
+        if (m_runners.at(i)->m_job.m_task == task)
+            m_runners.at(i)->m_job.cancel();
+}
+
+void
+Gatherer::abandon(const Task task)
+{
+    //a runner stuck in a syscall cant be cancelled, it is left to
+    //finish on its own and only blocks jobs that conflict with it
+    QMutexLocker locker(&m_mutex);
+    for (int i = m_runners.count()-1; i > -1; --i)
+    {
+        Runner *runner = m_runners.at(i);
+        if (runner->m_job.m_task != task)
+            continue;
+        runner->m_job.cancel();
+        m_runners.removeAt(i);
+        m_abandoned << runner;
+        connect(runner, SIGNAL(finished()), runner, SLOT(deleteLater()));
+    }
+    spawnRunners();
+    m_jobCond.wakeAll();
+    locker.unlock();
+    checkWorking();
+}
+
+//lets every runner go, the next job spawns new ones
+void
+Gatherer::release()
 {
-    setCancelled(true);
-    wait();
-    setCancelled(false);
+    QMutexLocker locker(&m_mutex);
+    m_queue.clear();
+    for (int i = m_abandoned.count()-1; i > -1; --i)
+        if (!m_abandoned.at(i))
+            m_abandoned.removeAt(i);
+    for (int i = 0; i < m_runners.count(); ++i)
+    {
+        Runner *runner = m_runners.at(i);
+        runner->m_job.cancel();
+        m_abandoned << runner;
+        connect(runner, SIGNAL(finished()), runner, SLOT(deleteLater()));
+    }
+    m_runners.clear();
+    m_jobCond.wakeAll();
+    locker.unlock();
+    checkWorking();
+}
+
+//the model is going away, nobody waits on the runners. they
+//hold a ref each and the last one to return deletes the model
+void
+Gatherer::detach()
+{
+    m_mutex.lock();
+    m_quit = true;
+    m_mutex.unlock();
+    release();
+}
 
-    QMutexLocker locker(&m_taskMutex);
-    m_task = Search;
-    m_node = node;
+void
+Gatherer::search(const QString &name, const QString &path, Node *node)
+{
     m_searchName = name;
     m_searchPath = path;
-    start();
+    Job job(Search, node, path);
+    job.m_name = name;
+    enqueue(job);
 }
 
 void
 Gatherer::populateApplications(const QString &appsPath, Node *node)
 {
-    setCancelled(true);
-    wait();
-    setCancelled(false);
-
-    QMutexLocker locker(&m_taskMutex);
-    m_task = GetApps;
-    m_node = node;
-    m_appsPath = appsPath;
-    start();
+    enqueue(Job(GetApps, node, appsPath));
 }
 
+void
+Gatherer::prefetchPath(const QString &path, Node *parent)
+{
+    enqueue(Job(Generate, parent, path, Prefetch));
+}
 
 void
-Gatherer::populateNode(Node *node)
+Gatherer::sortNode(Node *node)
 {
-    if (m_task == Populate && node == m_node) //already populating the node....
-        return;
+    if (node)
+        enqueue(Job(Sort, node, QString(), Expanded));
+}
 
-    setCancelled(true);
-    wait();
-    setCancelled(false);
+void
+Gatherer::updateEntries(Node *node, const QStringList &added, const QStringList &removed, const QStringList &changed, const int priority)
+{
+    Job job(Update, node, QString(), priority);
+    job.m_added = added;
+    job.m_removed = removed;
+    job.m_changed = changed;
+    enqueue(job);
+}
 
-    QMutexLocker locker(&m_taskMutex);
-    m_task = Populate;
-    m_node = node;
-    start();
+void
+Gatherer::populateNode(Node *node, const int priority)
+{
+    if (node)
+        enqueue(Job(Populate, node, QString(), priority));
 }
 
 void
 Gatherer::generateNode(const QString &path, Node *parent)
 {
-    setCancelled(true);
-    wait();
-    setCancelled(false);
-
-    QMutexLocker locker(&m_taskMutex);
-    m_task = Generate;
-    m_path = path;
-    m_node = parent;
-    m_result = 0;
-    start();
+    enqueue(Job(Generate, parent, path));
 }
 
 void
@@ -141,7 +543,7 @@ Gatherer::getApplications(const QString &appsPath, Node *node)
     while (it.hasNext()&&!m_model->m_dataGatherer->isCancelled())
     {
         const QString &file(it.next());
-        if (QFileInfo(file).isDir())
+        if (QFileInfo(file).isDir() || node->child(file)) //a refresh lists them again
             continue;
         const QUrl &url = QUrl(QString("%1%2").arg(m_model->m_url.toString(), file));
         new AppNode(m_model, node, url, file);
@@ -152,12 +554,18 @@ Gatherer::getApplications(const QString &appsPath, Node *node)
 void
 Gatherer::searchResultsForNode(const QString &name, const QString &filePath, Node *node)
 {
-    QDirIterator it(filePath, allEntries, QDirIterator::Subdirectories);
-    while (it.hasNext()&&!m_model->m_dataGatherer->isCancelled())
+    SearchEngine engine(filePath, name, m_model->showHidden());
+    engine.start();
+    QStringList hits;
+    while (engine.takeHits(hits) && !isCancelled())
     {
-        const QFileInfo &file(it.next());
-        if (file.fileName().contains(name, Qt::CaseInsensitive))
-            new Node(m_model, QUrl::fromLocalFile(file.filePath()), node, file.filePath());
+        if (hits.isEmpty())
+            continue;
+        //one insert per batch instead of one per hit
+        node->startBatch();
+        for (int i = 0; i < hits.count(); ++i)
+            new Node(m_model, QUrl::fromLocalFile(hits.at(i)), node, hits.at(i));
+        node->endBatch();
     }
     emit m_model->urlLoaded(m_model->m_url);
 }
@@ -23,6 +23,13 @@
 #define FSWORKERS_H
 
 #include <QFileInfo>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <QPointer>
+#include <QAtomicInt>
+#include <QStringList>
 
 #include "objects.h"
 #include "dataloader.h"
@@ -36,51 +43,105 @@ class Node;
 class Model;
 namespace Worker
 {
-enum Task { Populate = 0, Generate, Search, GetApps, NoTask };
+enum Task { Populate = 0, Generate, Search, GetApps, Sort, Update, NoTask };
+enum Priority { Prefetch = 0, Expanded, Current };
 
 class Job
 {
 public:
-    Job(const Task &t, Node *node, const QString &path)
-        : m_task(t)
-        , m_node(node)
+    Job(const Task &t = NoTask, Node *node = 0, const QString &path = QString(), const int priority = Current)
+        : m_node(node)
         , m_path(path)
+        , m_task(t)
+        , m_priority(priority)
     {
+        if (t != NoTask)
+            m_token = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
     }
+    //same work, whoever asked for it and how urgently
+    inline bool operator==(const Job &j) const { return m_task == j.m_task && m_node == j.m_node && m_path == j.m_path && m_name == j.m_name; }
+    inline bool isCancelled() const { return m_token && m_token->fetchAndAddRelaxed(0); }
+    inline void cancel() const { if (m_token) m_token->fetchAndStoreRelaxed(1); }
+
     Node *m_node;
-    QString m_path;
+    QString m_path, m_name;
+    QStringList m_added, m_removed, m_changed; //entry names of an update
     Task m_task;
+    int m_priority;
+    QSharedPointer<QAtomicInt> m_token; //shared by all copies of the job
 };
 
 typedef QList<Job> Jobs;
 
-class Gatherer : public DThread
+class Gatherer;
+class Runner : public QThread
+{
+public:
+    explicit Runner(Gatherer *gatherer);
+    inline bool isCancelled() const { return m_job.isCancelled(); }
+
+protected:
+    void run();
+
+private:
+    Gatherer *m_gatherer;
+    Job m_job; //written by this thread only, under the gatherer mutex
+    friend class Gatherer;
+};
+
+class Gatherer : public QObject
 {
     Q_OBJECT
 public:
     explicit Gatherer(QObject *parent = 0);
-    void populateNode(Node *node);
+    ~Gatherer();
+    void populateNode(Node *node, const int priority = Current);
     void generateNode(const QString &path, Node *parent);
     void search(const QString &name, const QString &filePath, Node *node);
     void populateApplications(const QString &appsPath, Node *node);
-    void setCancelled(bool cancel);
-    bool isCancelled() { QMutexLocker locker(&m_pausingMutex); return m_isCancelled; }
+    void prefetchPath(const QString &path, Node *parent);
+    void sortNode(Node *node);
+    void updateEntries(Node *node, const QStringList &added, const QStringList &removed, const QStringList &changed, const int priority = Expanded);
+    void cancel(const Task task);
+    void abandon(const Task task);
+    void release();
+    void detach();
+    void shutdown();
+    bool isCancelled() const;
+    bool isWorking() const;
+    bool isIdle() const;
 
 protected:
-    void run();
+    void enqueue(Job job);
+    bool takeJob(Runner *runner, Job &job);
+    void finishJob(Runner *runner);
+    void runJob(const Job &job);
+    bool isBlocked(const Job &job) const;
+    void spawnRunners();
+    void prefetchData(Node *node, const Job &job);
+    void statForSort(Node *node, const Job &job);
     void searchResultsForNode(const QString &name, const QString &filePath, Node *node);
     void getApplications(const QString &appsPath, Node *node);
 
 signals:
     void nodeGenerated(const QString &path, Node *node);
+    void startedWorking();
+    void finishedWorking();
+    void jobFinished();
+
+private slots:
+    void checkWorking();
 
 private:
-    QString m_path, m_searchPath, m_searchName, m_appsPath;
-    QMutex m_taskMutex;
-    Node *m_node, *m_result;
+    QString m_searchPath, m_searchName;
+    mutable QMutex m_mutex;
+    QWaitCondition m_jobCond;
+    Jobs m_queue; //highest priority first, fifo within one
+    QList<Runner *> m_runners;
+    QList<QPointer<Runner> > m_abandoned;
     FS::Model *m_model;
-    Task m_task;
-    bool m_isCancelled;
+    bool m_working, m_quit;
+    friend class Runner;
     friend class Node;
     friend class FS::Model;
 };
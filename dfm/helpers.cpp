@@ -1,10 +1,46 @@
 #include "helpers.h"
 #include "searchbox.h"
 #include "mainwindow.h"
+#include "dataloader.h"
+#include "fsmodel.h"
+#include "globals.h"
 
 #include <QDateTime>
 #include <QSettings>
 #include <QDebug>
+#include <QAbstractItemView>
+#include <QFile>
+
+#if defined(ISUNIX)
+#include <sys/stat.h>
+#endif
+
+DFM::FileStamp
+DFM::FileStamp::fromFile(const QString &file)
+{
+    FileStamp stamp;
+    if (file.isEmpty())
+        return stamp;
+#if defined(ISUNIX)
+    struct stat st;
+    if (::stat(QFile::encodeName(file).constData(), &st))
+        return stamp;
+#if defined(Q_OS_LINUX)
+    stamp.mtime = qint64(st.st_mtim.tv_sec)*Q_INT64_C(1000000000) + st.st_mtim.tv_nsec;
+#else
+    stamp.mtime = qint64(st.st_mtime)*Q_INT64_C(1000000000);
+#endif
+    stamp.size = st.st_size;
+    stamp.inode = st.st_ino;
+#else
+    const QFileInfo fi(file);
+    if (!fi.exists())
+        return stamp;
+    stamp.mtime = fi.lastModified().toMSecsSinceEpoch()*Q_INT64_C(1000000);
+    stamp.size = fi.size();
+#endif
+    return stamp;
+}
 
 DMimeProvider::DMimeProvider()
 {
@@ -240,3 +276,83 @@ DFM::DViewBase::keyPressEvent(QKeyEvent *ke)
         }
     }
 }
+
+DFM::DViewBase::~DViewBase()
+{
+    clearViewport();
+}
+
+void
+DFM::DViewBase::clearViewport()
+{
+    m_firstVisible = QModelIndex();
+    m_lastVisible = QModelIndex();
+    DDataLoader::setVisible(this, QStringList());
+}
+
+QModelIndexList
+DFM::DViewBase::visibleIndexes(QAbstractItemView *view) const
+{
+    QModelIndexList visible;
+    const QAbstractItemModel *model = view->model();
+    const QModelIndex &root = view->rootIndex();
+    const QRect &vr = view->viewport()->rect();
+    const int rows = model->rowCount(root);
+
+    //find the first row reaching into the viewport...
+    int lo = 0, hi = rows;
+    while (lo < hi)
+    {
+        const int mid = (lo+hi)/2;
+        const QRect &r = view->visualRect(model->index(mid, 0, root));
+        if (r.isValid() && r.bottom() < vr.top())
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    //...and walk from there until we are below it
+    for (int i = lo; i < rows; ++i)
+    {
+        const QModelIndex &index = model->index(i, 0, root);
+        const QRect &r = view->visualRect(index);
+        if (r.top() > vr.bottom())
+            break;
+        if (r.intersects(vr))
+            visible << index;
+    }
+    return visible;
+}
+
+void
+DFM::DViewBase::reportViewport(QAbstractItemView *view)
+{
+    if (!view->model() || !view->isVisible())
+        return;
+
+    const QModelIndexList &visible = visibleIndexes(view);
+    const QModelIndex &first = visible.isEmpty() ? QModelIndex() : visible.first();
+    const QModelIndex &last = visible.isEmpty() ? QModelIndex() : visible.last();
+    if (m_firstVisible == first && m_lastVisible == last)
+        return;
+    m_firstVisible = first;
+    m_lastVisible = last;
+
+    QStringList files, near;
+    for (int i = 0; i < visible.count(); ++i)
+        files << visible.at(i).data(FS::FilePathRole).toString();
+    if (FS::Model *fsModel = qobject_cast<FS::Model *>(view->model()))
+        fsModel->statRows(visible);
+
+    //one page above and below is what the user most likely sees next
+    if (first.isValid())
+    {
+        const QAbstractItemModel *model = view->model();
+        const int page = visible.count();
+        for (int i = qMax(0, first.row()-page); i < first.row(); ++i)
+            near << model->index(i, 0, first.parent()).data(FS::FilePathRole).toString();
+        const int rows = model->rowCount(last.parent());
+        for (int i = last.row()+1; i < qMin(rows, last.row()+1+page); ++i)
+            near << model->index(i, 0, last.parent()).data(FS::FilePathRole).toString();
+    }
+    DDataLoader::setVisible(this, files, near);
+}
@@ -5,7 +5,12 @@
 #include <QMutex>
 #include <QKeyEvent>
 #include <QHash>
+#include <QSet>
 #include <QQueue>
+#include <QReadWriteLock>
+#include <QPersistentModelIndex>
+
+class QAbstractItemView;
 
 #if defined(HASMAGIC)
 #include <magic.h>
@@ -29,6 +34,24 @@ private:
 namespace DFM
 {
 
+//identity of a file version, a cached Data is valid as long
+//as the stamp it was made with matches the one of the node.
+class FileStamp
+{
+public:
+    FileStamp() : mtime(0), size(-1), inode(0) {}
+    static FileStamp fromFile(const QString &file);
+    inline bool isNull() const { return size == -1; }
+    inline bool operator==(const FileStamp &s) const { return mtime == s.mtime && size == s.size && inode == s.inode; }
+    inline bool operator!=(const FileStamp &s) const { return !operator==(s); }
+    inline uint secs() const { return uint(mtime/Q_INT64_C(1000000000)); }
+    inline qint64 msecs() const { return mtime/Q_INT64_C(1000000); }
+
+    qint64 mtime; //ns since the epoch
+    qint64 size;
+    quint64 inode;
+};
+
 class DTrash
 {
 public:
@@ -48,41 +71,157 @@ class DViewBase
 {
 public:
     DViewBase(){}
-    ~DViewBase(){}
+    virtual ~DViewBase();
 
 protected:
     virtual void keyPressEvent(QKeyEvent *ke);
+    //tells the dataloader what is on screen so that gets loaded first,
+    //only does any work when the visible range actually changed.
+    void reportViewport(QAbstractItemView *view);
+    void clearViewport();
+    //default assumes rows are laid out top to bottom in model order.
+    virtual QModelIndexList visibleIndexes(QAbstractItemView *view) const;
+
+private:
+    QPersistentModelIndex m_firstVisible, m_lastVisible;
 };
 
-//convenience wrapper for thread-safe hashing...
-template <typename Key, typename Val>
+//thread-safe hash split in shards, each behind its own read-write lock.
+//readers never wait for each other, and only wait for a writer that
+//happens to be in the same shard.
+template <typename Key, typename Val, int Shards = 16>
 class DHash
 {
 public:
-    void insert(Key key, Val val)           { QMutexLocker locker(&m_mutex); m_hash.insert(key, val); }
-    Val value(Key key, Val defaultValue)    { QMutexLocker locker(&m_mutex); return m_hash.value(key, defaultValue); }
-    int count()                             { QMutexLocker locker(&m_mutex); return m_hash.count(); }
-    bool contains(Key key)                  { QMutexLocker locker(&m_mutex); return m_hash.contains(key); }
-    void destroy(Key key)                   { QMutexLocker locker(&m_mutex); if (m_hash.contains(key)) delete m_hash.take(key); }
+    void insert(const Key &key, Val val)            { Shard &s = shard(key); QWriteLocker locker(&s.lock); s.hash.insert(key, val); }
+    Val value(const Key &key, Val defaultValue)     { Shard &s = shard(key); QReadLocker locker(&s.lock); return s.hash.value(key, defaultValue); }
+    bool contains(const Key &key)                   { Shard &s = shard(key); QReadLocker locker(&s.lock); return s.hash.contains(key); }
+    void destroy(const Key &key)
+    {
+        Shard &s = shard(key);
+        QWriteLocker locker(&s.lock);
+        typename QHash<Key, Val>::iterator it = s.hash.find(key);
+        if (it == s.hash.end())
+            return;
+        delete it.value();
+        s.hash.erase(it);
+    }
+    int count()
+    {
+        int c = 0;
+        for (int i = 0; i < Shards; ++i)
+        {
+            QReadLocker locker(&m_shards[i].lock);
+            c += m_shards[i].hash.count();
+        }
+        return c;
+    }
 
 private:
-    mutable QMutex m_mutex;
-    QHash<Key, Val> m_hash;
+    struct Shard
+    {
+        QReadWriteLock lock;
+        QHash<Key, Val> hash;
+    };
+    inline Shard &shard(const Key &key)
+    {
+        uint h = qHash(key);
+        h ^= h >> 16; //the low bits pick the bucket inside the shard too
+        return m_shards[h % Shards];
+    }
+    Shard m_shards[Shards];
 };
 
+//thread-safe queue with unique entries, a plain mutex around a queue
+//and a set. the set makes the dedupe O(1) so the lock is held only
+//briefly, no linear search for producers to convoy behind.
 template <typename T>
 class DQueue
 {
 public:
-    bool enqueue(T t)                       { QMutexLocker locker(&m_mutex); if (m_queue.contains(t)) return false; m_queue.enqueue(t); return true; }
-    T dequeue()                             { QMutexLocker locker(&m_mutex); return m_queue.dequeue(); }
-    bool contains(T t)                      { QMutexLocker locker(&m_mutex); return m_queue.contains(t); }
-    void clear()                            { QMutexLocker locker(&m_mutex); m_queue.clear(); }
+    bool enqueue(const T &t)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_set.contains(t))
+            return false;
+        m_set.insert(t);
+        m_queue.enqueue(t);
+        return true;
+    }
+    T dequeue()                             { QMutexLocker locker(&m_mutex); const T t = m_queue.dequeue(); m_set.remove(t); return t; }
+    bool dequeue(T &t)                      { QMutexLocker locker(&m_mutex); if (m_queue.isEmpty()) return false; t = m_queue.dequeue(); m_set.remove(t); return true; }
+    int count()                             { QMutexLocker locker(&m_mutex); return m_queue.count(); }
+    bool contains(const T &t)               { QMutexLocker locker(&m_mutex); return m_set.contains(t); }
+    void clear()                            { QMutexLocker locker(&m_mutex); m_queue.clear(); m_set.clear(); }
     bool isEmpty()                          { QMutexLocker locker(&m_mutex); return m_queue.isEmpty(); }
 
 private:
     mutable QMutex m_mutex;
     QQueue<T> m_queue;
+    QSet<T> m_set;
+};
+
+//thread-safe queue with a few priority levels, 0 being the most urgent.
+//entries are unique, and moving one to another level is O(1) as the
+//old position is just left behind and skipped when dequeued.
+template <typename T, int Levels = 3>
+class DPriorityQueue
+{
+public:
+    bool enqueue(T t, const int level)
+    {
+        QMutexLocker locker(&m_mutex);
+        typename QHash<T, int>::iterator it = m_levels.find(t);
+        if (it != m_levels.end())
+        {
+            if (it.value() <= level)
+                return false;
+            it.value() = level;
+        }
+        else
+            m_levels.insert(t, level);
+        m_queues[level].enqueue(t);
+        return true;
+    }
+    bool setLevel(T t, const int level)
+    {
+        QMutexLocker locker(&m_mutex);
+        typename QHash<T, int>::iterator it = m_levels.find(t);
+        if (it == m_levels.end())
+            return false;
+        if (it.value() != level)
+        {
+            it.value() = level;
+            m_queues[level].enqueue(t);
+        }
+        return true;
+    }
+    bool dequeue(T &t)
+    {
+        QMutexLocker locker(&m_mutex);
+        for (int i = 0; i < Levels; ++i)
+            while (!m_queues[i].isEmpty())
+            {
+                const T candidate = m_queues[i].dequeue();
+                typename QHash<T, int>::iterator it = m_levels.find(candidate);
+                if (it == m_levels.end() || it.value() != i)
+                    continue; //moved to another level or removed
+                m_levels.erase(it);
+                t = candidate;
+                return true;
+            }
+        return false;
+    }
+    void remove(T t)                        { QMutexLocker locker(&m_mutex); m_levels.remove(t); }
+    bool contains(T t)                      { QMutexLocker locker(&m_mutex); return m_levels.contains(t); }
+    void clear()                            { QMutexLocker locker(&m_mutex); m_levels.clear(); for (int i = 0; i < Levels; ++i) m_queues[i].clear(); }
+    bool isEmpty()                          { QMutexLocker locker(&m_mutex); return m_levels.isEmpty(); }
+    int count()                             { QMutexLocker locker(&m_mutex); return m_levels.count(); }
+
+private:
+    mutable QMutex m_mutex;
+    QHash<T, int> m_levels;
+    QQueue<T> m_queues[Levels];
 };
 
 template <typename T>
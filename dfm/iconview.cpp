@@ -237,6 +237,8 @@ IconView::IconView(QWidget *parent)
     , m_newSize(0)
     , m_gridHeight(0)
     , m_horItems(0)
+    , m_contentsHeight(0)
+    , m_laidOut(0)
     , m_scrollTimer(new QTimer(this))
     , m_sizeTimer(new QTimer(this))
     , m_layTimer(new QTimer(this))
@@ -338,6 +340,13 @@ IconView::showEvent(QShowEvent *e)
     updateLayout();
 }
 
+void
+IconView::hideEvent(QHideEvent *e)
+{
+    QAbstractItemView::hideEvent(e);
+    clearViewport();
+}
+
 void
 IconView::keyPressEvent(QKeyEvent *event)
 {
@@ -546,6 +555,7 @@ IconView::renderCategory(const QString &category, const QRect &catRect, QPainter
 void
 IconView::paintEvent(QPaintEvent *e)
 {
+    reportViewport(this);
     QPainter p(viewport());
     p.setClipRect(e->rect());
     if (isCategorized())
@@ -558,10 +568,14 @@ IconView::paintEvent(QPaintEvent *e)
                 continue;
 
             renderCategory(category, catRect, &p, cat);
-            const QModelIndexList &block(static_cast<FS::Model *>(model())->category(category));
-            for (int i = 0; i < block.count(); ++i)
+            if (cat >= m_catBlocks.count())
+                continue;
+            const CatBlock &block = m_catBlocks.at(cat);
+            QVector<int> cells;
+            cellsIn(e->rect(), block.itemTop, block.indexes.count(), cells);
+            for (int i = 0; i < cells.count(); ++i)
             {
-                const QModelIndex &index(block.at(i));
+                const QModelIndex &index(block.indexes.at(cells.at(i)));
                 const QRect vr(visualRect(index));
                 if (!e->rect().intersects(vr))
                     continue;
@@ -575,12 +589,11 @@ IconView::paintEvent(QPaintEvent *e)
     }
     else
     {
-        for (int i = 0; i < model()->rowCount(rootIndex()); ++i)
+        const QModelIndexList &indexes = indexesIn(e->rect());
+        for (int i = 0; i < indexes.count(); ++i)
         {
-            const QModelIndex &index(model()->index(i, 0, rootIndex()));
+            const QModelIndex &index(indexes.at(i));
             const QRect vr(visualRect(index));
-            if (!e->rect().intersects(vr))
-                continue;
             QStyleOptionViewItemV4 option(viewOptions());
             option.rect=vr;
             option.widget=this;
@@ -620,6 +633,79 @@ IconView::paintEvent(QPaintEvent *e)
     p.end();
 }
 
+QModelIndexList
+IconView::visibleIndexes(QAbstractItemView *view) const
+{
+    if (!isCategorized())
+        return DViewBase::visibleIndexes(view);
+
+    //categories dont keep the model order, ask the grid
+    return indexesIn(viewport()->rect());
+}
+
+QRect
+IconView::cellRect(const int top, const int cell) const
+{
+    const int hsz = gridSize().width();
+    const int vsz = gridSize().height();
+    return QRect(hsz*(cell%m_horItems), top+vsz*(cell/m_horItems), hsz, vsz);
+}
+
+void
+IconView::cellsIn(const QRect &rect, const int top, const int count, QVector<int> &cells) const
+{
+    const int hsz = gridSize().width();
+    const int vsz = gridSize().height();
+    if (!count || !m_horItems || hsz <= 0 || vsz <= 0)
+        return;
+    //rect is in viewport coordinates, the grid in contents coordinates
+    const QRect r = rect.translated(0, verticalOffset());
+    const int rows = (count+m_horItems-1)/m_horItems;
+    if (r.bottom() < top || r.top() >= top+rows*vsz || r.right() < 0)
+        return;
+    const int firstRow = qMax(0, (r.top()-top)/vsz);
+    const int lastRow = qMin(rows-1, (r.bottom()-top)/vsz);
+    const int firstCol = qMax(0, r.left()/hsz);
+    const int lastCol = qMin(m_horItems-1, r.right()/hsz);
+    for (int row = firstRow; row <= lastRow; ++row)
+        for (int col = firstCol; col <= lastCol; ++col)
+        {
+            const int cell = row*m_horItems+col;
+            if (cell >= count)
+                return;
+            cells << cell;
+        }
+}
+
+QModelIndexList
+IconView::indexesIn(const QRect &rect) const
+{
+    QModelIndexList indexes;
+    if (!model() || !m_horItems)
+        return indexes;
+    QVector<int> cells;
+    if (!isCategorized())
+    {
+        cellsIn(rect, 0, qMin(m_laidOut, model()->rowCount(rootIndex())), cells);
+        for (int i = 0; i < cells.count(); ++i)
+            indexes << model()->index(cells.at(i), 0, rootIndex());
+        return indexes;
+    }
+    for (int cat = 0; cat < m_catBlocks.count(); ++cat)
+    {
+        const CatBlock &block = m_catBlocks.at(cat);
+        cells.clear();
+        cellsIn(rect, block.itemTop, block.indexes.count(), cells);
+        for (int i = 0; i < cells.count(); ++i)
+        {
+            const QModelIndex &index = block.indexes.at(cells.at(i));
+            if (index.isValid())
+                indexes << index;
+        }
+    }
+    return indexes;
+}
+
 void
 IconView::setGridHeight(int gh)
 {
@@ -695,9 +781,18 @@ IconView::setIconWidth(const int width)
 QRect
 IconView::visualRect(const QModelIndex &index) const
 {
-    if (!index.isValid()||index.column()||!m_horItems||!m_rects.contains(index))
+    if (!index.isValid()||index.column()||!m_horItems)
         return QRect();
 
+    //uncategorized the row is the cell, no need to look anything up
+    if (!isCategorized())
+    {
+        if (index.row() >= m_laidOut || index.parent() != rootIndex())
+            return QRect();
+        return cellRect(0, index.row()).translated(0, -verticalOffset());
+    }
+    if (!m_rects.contains(index))
+        return QRect();
     return m_rects.value(index, QRect()).translated(0, -verticalOffset());
 }
 
@@ -712,12 +807,12 @@ IconView::indexAt(const QPoint &p) const
 {
     if (!testAttribute(Qt::WA_WState_Created))
         return QModelIndex();
-    for (int i = 0; i < model()->rowCount(rootIndex()); ++i)
+    //at most one cell under a point
+    const QModelIndexList &indexes = indexesIn(QRect(p, QSize(1, 1)));
+    for (int i = 0; i < indexes.count(); ++i)
     {
-        const QModelIndex &index(model()->index(i, 0, rootIndex()));
+        const QModelIndex &index(indexes.at(i));
         const QRect r(visualRect(index));
-//        if (!viewport()->rect().intersects(r))
-//            continue;
         if (r.contains(p))
             if (static_cast<IconDelegate *>(itemDelegate())->isHitted(index, p, r))
                 return index;
@@ -795,6 +890,8 @@ IconView::calculateRects()
         return;
     m_rects.clear();
     m_catRects.clear();
+    m_catBlocks.clear();
+    m_laidOut = 0;
     static_cast<IconDelegate *>(itemDelegate())->clearData();
     const int hsz = gridSize().width();
     const int vsz = gridSize().height();
@@ -814,6 +911,10 @@ IconView::calculateRects()
             m_contentsHeight+=fm.height();
             int col = -1;
             const QModelIndexList &block(static_cast<FS::Model *>(model())->category(m_categories.at(cat)));
+            CatBlock catBlock;
+            catBlock.itemTop = m_contentsHeight;
+            catBlock.indexes = block;
+            m_catBlocks << catBlock;
             for (int i = 0; i < block.count(); ++i)
             {
                 if (col+1==m_horItems)
@@ -832,14 +933,10 @@ IconView::calculateRects()
     }
     else
     {
-        for (int i = 0; i < model()->rowCount(rootIndex()); ++i)
-        {
-            const QModelIndex &index(model()->index(i, 0, rootIndex()));
-            const int col = i % m_horItems;
-            m_contentsHeight = vsz * (i / m_horItems);
-            if (index.isValid())
-                m_rects.insert(index, QRect(hsz*col, m_contentsHeight, hsz, vsz));
-        }
+        //a plain grid, visualRect() and indexesIn() work it out from the row
+        m_laidOut = model()->rowCount(rootIndex());
+        if (m_laidOut)
+            m_contentsHeight = vsz * ((m_laidOut-1) / m_horItems);
     }
     m_contentsHeight+=vsz;
     if (m_contentsHeight > viewport()->height())
@@ -932,13 +1029,25 @@ void
 IconView::setSelection(const QRect &rect, QItemSelectionModel::SelectionFlags flags)
 {
     QItemSelection selection;
-    for (int i = 0; i < model()->rowCount(rootIndex()); ++i)
+    const QModelIndexList &indexes = indexesIn(rect);
+    //neighbouring rows go in as one range
+    QModelIndex first, last;
+    for (int i = 0; i < indexes.count(); ++i)
     {
-        const QModelIndex &index(model()->index(i, 0, rootIndex()));
-        const QRect vr(visualRect(index));
-        if (rect.intersects(vr))
-            selection.select(index, index);
+        const QModelIndex &index(indexes.at(i));
+        if (!rect.intersects(visualRect(index)))
+            continue;
+        if (last.isValid() && index.row() == last.row()+1 && index.parent() == last.parent())
+        {
+            last = index;
+            continue;
+        }
+        if (first.isValid())
+            selection.select(first, last);
+        first = last = index;
     }
+    if (first.isValid())
+        selection.select(first, last);
     selectionModel()->select(selection, flags);
 }
 
@@ -23,6 +23,7 @@
 #define ICONVIEW_H
 
 #include <QAbstractItemView>
+#include <QVector>
 #include "helpers.h"
 
 namespace DFM
@@ -52,6 +53,7 @@ protected:
     void paintEvent(QPaintEvent *e);
     void keyPressEvent(QKeyEvent *e);
     void showEvent(QShowEvent *e);
+    void hideEvent(QHideEvent *e);
     QRect visualRect(const QModelIndex &index) const;
     QRect visualRect(const QString &cat) const;
     QModelIndex indexAt(const QPoint &p) const;
@@ -62,6 +64,8 @@ protected:
     static bool isCategorized();
     void renderCategory(const QString &category, const QRect &catRect, QPainter *p = 0, const int index = 0);
     QStyleOptionViewItem viewOptions() const;
+    QModelIndexList visibleIndexes(QAbstractItemView *view) const;
+    QModelIndexList indexesIn(const QRect &rect) const;
 
     int horizontalOffset() const;
     bool isIndexHidden(const QModelIndex & index) const;
@@ -91,16 +95,27 @@ private slots:
     void sizeTimerEvent();
 
 private:
+    //where the items of a category start and which they are,
+    //a cell n in it sits at column n%m_horItems, row n/m_horItems
+    struct CatBlock
+    {
+        int itemTop;
+        QModelIndexList indexes;
+    };
+    QRect cellRect(const int top, const int cell) const;
+    void cellsIn(const QRect &rect, const int top, const int count, QVector<int> &cells) const;
+
     QSize m_gridSize, m_prevSize;
     QStringList m_categories;
     QPoint m_startPos, m_pressPos;
     QList<int> m_allowedSizes;
     QHash<QModelIndex, QRect> m_rects;
     QHash<QString, QRect> m_catRects;
+    QVector<CatBlock> m_catBlocks;
     bool m_slide, m_startSlide, m_hadSelection;
     QTimer *m_sizeTimer, *m_layTimer, *m_scrollTimer, *m_resizeTimer;
     QModelIndex m_firstIndex, m_pressedIndex;
-    int m_newSize, m_gridHeight, m_horItems, m_contentsHeight;
+    int m_newSize, m_gridHeight, m_horItems, m_contentsHeight, m_laidOut;
     QList<int> m_scrollValues;
 };
 }
@@ -36,8 +36,14 @@ public:
     virtual QString name() const = 0;
     virtual QString description() const = 0;
     virtual bool thumb(const QString &file, const QString &mime, QImage &thumb, const int size = 256) = 0;
+    //plugins that can generate several thumbs at the same time from
+    //different threads return true here, others are only ever called
+    //from the thread they were initialized in, one file at a time.
+    virtual bool isThreadSafe() const { return false; }
+    //how many thumbs a threadsafe plugin may generate at once, 0 means one per core.
+    virtual int maxConcurrency() const { return 0; }
 };
 
-Q_DECLARE_INTERFACE(ThumbInterface, "dfm.ThumbInterface/0.01")
+Q_DECLARE_INTERFACE(ThumbInterface, "dfm.ThumbInterface/0.02")
 
 #endif // INTERFACES_H
@@ -23,6 +23,21 @@
 #include <QMessageBox>
 #include <QLocalSocket>
 #include <QProcess>
+#include <QSet>
+#if defined(ISUNIX)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+#if defined(HASFICLONE)
+#include <linux/fs.h>
+#endif
+#if defined(HASSENDFILE)
+#include <sys/sendfile.h>
+#endif
 
 #include "iojob.h"
 #include "operations.h"
@@ -241,6 +256,13 @@ CopyDialog::setInfo(QString from, QString to, int completeProgress, int currentP
     }
 }
 
+void
+CopyDialog::setCounting(const bool counting)
+{
+    //while we are still counting the total is only what we know so far
+    m_progress->setFormat(counting ? tr("%p% (still counting)") : QString("%p%"));
+}
+
 void
 CopyDialog::finished()
 {
@@ -340,6 +362,7 @@ Manager::Manager(QObject *parent)
     , m_cut(false)
     , m_total(0) //size in bytes of all files we are going to copy/move
     , m_allProgress(0) //overall progress
+    , m_spaceChecked(0)
     , m_inProgress(0) //current file progress
     , m_fileProgress(0) //written bytes to the file we are currently working on, also used to check if clone was succesful
     , m_diffCheck(0) //used to calculate speed
@@ -350,6 +373,8 @@ Manager::Manager(QObject *parent)
     , m_speedTimer(new QTimer(this))
     , m_mode(Continue)
     , m_copyDialog(new CopyDialog())
+    , m_pool(new QThreadPool(this))
+    , m_scanner(new Scanner(this))
 {
     m_copyDialog->setSizeGripEnabled(false);
     m_timer->setInterval(100);
@@ -364,6 +389,7 @@ Manager::Manager(QObject *parent)
     connect(this, SIGNAL(speed(QString)), m_copyDialog, SLOT(setSpeed(QString)));
     connect(this, SIGNAL(copyOrMoveStarted()), m_copyDialog, SLOT(show()));
     connect(this, SIGNAL(isMove(bool)), m_copyDialog, SLOT(setMove(bool)));
+    connect(this, SIGNAL(counting(bool)), m_copyDialog, SLOT(setCounting(bool)));
 
     connect(this, SIGNAL(finished()), this, SLOT(finishedSlot()));
     connect(this, SIGNAL(fileExists(QStringList)), this, SLOT(fileExistsSlot(QStringList)));
@@ -413,34 +439,53 @@ Manager::doJob(const IOJobData &ioJobData)
         m_destDir = ioJobData.outPath;
         m_total = 0;
         const QStringList copyFiles = ioJobData.inList;
-        if (!getTotalSize(copyFiles, m_total))
+        if (!canCopy(copyFiles))
             return;
 
-        emit copyOrMoveStarted();
+        //sizes are counted while we already copy, and what
+        //we can just rename doesnt need to be counted at all.
+        QList<Inventory *> inventories;
+        QList<bool> renames;
         foreach (const QString &file, copyFiles)
+        {
+            Inventory *inventory = new Inventory();
+            renames << bool(m_cut && Ops::sameDisk(file, m_destDir));
+            if (renames.last())
+                inventory->finish();
+            inventories << inventory;
+        }
+        m_scanner->scan(copyFiles, inventories);
+
+        emit copyOrMoveStarted();
+        for (int i = 0; i < copyFiles.count(); ++i)
         {
             if (m_canceled)
                 break;
-            m_inFile = file;
-            m_outFile = QDir(m_destDir).absoluteFilePath(QFileInfo(file).fileName());
-            const bool sameDisk = Ops::sameDisk(file, m_destDir);
-            const bool canRename = bool(m_cut && sameDisk);
+            const QString &file = copyFiles.at(i);
+            setCurrent(file, QDir(m_destDir).absoluteFilePath(QFileInfo(file).fileName()));
 
-            if (canRename)
+            if (renames.at(i))
             {
                 if (!QFile::rename(m_inFile, m_outFile))
                     error(s_errorBase.arg(m_inFile, m_outFile, m_destDir));
                 continue;
             }
-#if defined(HASSYS)
-            if (m_total > Ops::getDriveInfo<Ops::Free>(m_destDir))
-                error(QString("Not enough space on %1").arg(m_destDir));
-#endif
-            if (!copyRecursive(file, m_outFile, m_cut, sameDisk))
+            //only what is scanned so far, copyInventory() checks
+            //again whenever the scanner found more
+            if (!checkSpace())
+                break;
+            const bool parallel = Store::config.behaviour.copyQueueDepth > 1 && QFileInfo(file).isDir();
+            const bool copied = copyInventory(file, inventories.at(i), parallel);
+            if (m_canceled) //out of space or given up half way, the source stays
+                break;
+            if (!copied)
                 error(s_errorBase.arg(m_inFile, m_outFile, m_destDir));
             else if (m_cut)
                 remove(file);
         }
+        m_scanner->cancel();
+        m_scanner->wait();
+        qDeleteAll(inventories);
         emit copyOrMoveFinished();
     }
     else if (ioJobData.ioTask == RemoveTask)
@@ -474,6 +519,7 @@ Manager::reset()
     m_inProgress = 0; //current file progress
     m_fileProgress = 0; //written bytes to the file we are currently working on, also used to check if clone was succesful
     m_diffCheck = 0; //used to calculate speed
+    m_spaceChecked = 0; //scanned bytes at the last free space check
     m_destDir = QString(); //destination
     m_newFile = QString(); //new name of file when file exists
     m_outFile = QString(); //file we are currently copying to
@@ -490,34 +536,35 @@ Manager::error(const QString &error)
     pause();
 }
 
-void
-Manager::getDirs(const QString &dir, quint64 &fileSize)
-{
-    const QFileInfoList &entries = QDir(dir).entryInfoList(allEntries);
-    foreach (const QFileInfo &entry, entries)
-    {
-        if (entry.isDir())
-            getDirs(entry.filePath(), fileSize);
-        else
-            fileSize += entry.size();
-    }
-}
-
 bool
-Manager::getTotalSize(const QStringList &copyFiles, quint64 &fileSize)
+Manager::canCopy(const QStringList &copyFiles) const
 {
     foreach (const QString &file, copyFiles)
-    {
         if (QFileInfo(file).isDir())
             if (m_destDir.startsWith(file) || (QFileInfo(file).path() == m_destDir && m_cut))
                 return false;
+    return true;
+}
 
-        QFileInfo fileInfo(file);
-        if (fileInfo.isDir())
-            getDirs(file, fileSize);
-        else
-            fileSize += fileInfo.size();
+//the scanner counts while we copy, what it found since the
+//last look is checked against what is left on the destination
+bool
+Manager::checkSpace()
+{
+#if defined(HASSYS)
+    const quint64 scanned = m_scanner->bytes();
+    if (scanned == m_spaceChecked)
+        return true;
+    m_spaceChecked = scanned;
+    m_progressMtx.lock();
+    const quint64 done = m_allProgress;
+    m_progressMtx.unlock();
+    if (scanned > done && scanned-done > Ops::getDriveInfo<Ops::Free>(m_destDir))
+    {
+        error(QString("Not enough space on %1").arg(m_destDir));
+        return false;
     }
+#endif
     return true;
 }
 
@@ -548,8 +595,16 @@ Manager::checkSpeed()
 void
 Manager::emitProgress()
 {
-    const int progress = currentProgress();
-    emit copyProgress(m_inFile, m_outFile, progress, m_fileProgress);
+    const bool isCounting = m_scanner->isRunning();
+    m_total = m_scanner->bytes();
+    int progress = currentProgress();
+    if (isCounting)
+        progress = qMin(progress, 99);
+    emit counting(isCounting);
+    m_progressMtx.lock();
+    const QString inFile(m_inFile), outFile(m_outFile);
+    m_progressMtx.unlock();
+    emit copyProgress(inFile, outFile, progress, m_fileProgress);
     if (!DFM::Store::config.behaviour.useIOQueue)
         return;
     QString task = m_cut?"Moving...":"Copying...";
@@ -620,76 +675,310 @@ Manager::setMode(Mode mode)
 }
 
 bool
-Manager::copyRecursive(const QString &inFile, const QString &outFile, bool cut, bool sameDisk)
+Manager::resolveConflict(const QString &inFile, QString &outFile)
 {
-    if (m_canceled)
-        return true;
-
-    const QFileInfo outFileInfo(outFile);
-
-    if (m_mode != OverwriteAll)
+    forever
     {
-        if (outFileInfo.exists())
+        const QFileInfo outFileInfo(outFile);
+
+        if (m_mode != OverwriteAll)
         {
-            if (m_mode == SkipAll)
-                return true;
-            emit fileExists(QStringList() << inFile << outFile);
-            setPause(true);
+            if (outFileInfo.exists())
+            {
+                if (m_mode == SkipAll)
+                    return false;
+                emit fileExists(QStringList() << inFile << outFile);
+                setPause(true);
+            }
         }
-    }
 
-    pause();
+        pause();
 
-    if (m_mode == SkipAll && outFileInfo.exists())
-        return true;
+        if (m_canceled)
+            return false;
 
-    if (m_mode == Overwrite || m_mode == OverwriteAll)
-    {
-        if (!QFileInfo(outFile).isDir())
-            remove(outFile);
-        if (m_mode == Overwrite)
+        if (m_mode == SkipAll && outFileInfo.exists())
+            return false;
+
+        if (m_mode == Overwrite || m_mode == OverwriteAll)
+        {
+            if (!QFileInfo(outFile).isDir())
+                remove(outFile);
+            if (m_mode == Overwrite)
+                m_mode = Continue;
+        }
+        else if (m_mode == Skip)
+        {
             m_mode = Continue;
+            return false;
+        }
+
+        if (m_mode == NewName && !m_newFile.isEmpty())
+        {
+            //the new name might exist as well, so once more
+            m_mode = Continue;
+            outFile = m_newFile;
+            m_newFile = QString();
+            continue;
+        }
+        return true;
     }
-    else if (m_mode == Skip)
+}
+
+namespace DFM
+{
+namespace IO
+{
+class CopyTask : public QRunnable
+{
+public:
+    CopyTask(Manager *manager, const QString &in, const QString &out, QSemaphore *deviceQueue)
+        : m_manager(manager), m_in(in), m_out(out), m_deviceQueue(deviceQueue) {}
+    void run()
     {
-        m_mode = Continue;
-        return true;
+        if (!m_manager->clone(m_in, m_out))
+            m_manager->copyFailed(m_in, m_out);
+        m_deviceQueue->release();
     }
+private:
+    Manager *m_manager;
+    QString m_in, m_out;
+    QSemaphore *m_deviceQueue;
+};
+}
+}
 
-    if (m_mode == NewName && !m_newFile.isEmpty())
+bool
+Manager::copyInventory(const QString &inFile, Inventory *inventory, const bool parallel)
+{
+    //entries are relative to the dir inFile is in, the
+    //dirs we made are remembered as conflicts can rename them.
+    const QString &inBase = QFileInfo(inFile).absolutePath();
+    QHash<QString, QString> outDirs;
+    QHash<QString, QSemaphore *> queues;
+    QSet<QString> skipped;
+    outDirs.insert(QString(), m_destDir);
+    if (parallel)
+        m_pool->setMaxThreadCount(qMax(1, Store::config.behaviour.copyQueueDepth));
+
+    bool ok = true;
+    Inventory::Entry entry;
+    for (int i = 0; ok && !m_canceled && inventory->at(i, entry); ++i)
     {
-        m_mode = Continue;
-        if (!copyRecursive(inFile, m_newFile, cut, sameDisk))
+        const int slash = entry.path.lastIndexOf(QLatin1Char('/'));
+        const QString &parent = slash == -1 ? QString() : entry.path.left(slash);
+        if (skipped.contains(parent))
         {
-            m_newFile = QString();
-            return false;
+            if (entry.isDir)
+                skipped.insert(entry.path);
+            continue;
         }
-        else return true;
+
+        const QString &in = parent.isEmpty() ? inFile : QString("%1/%2").arg(inBase, entry.path);
+        QString out = QString("%1/%2").arg(outDirs.value(parent), entry.path.mid(slash+1));
+        //conflicts are resolved here, one at a time, so
+        //the user only ever sees one dialog.
+        if (!resolveConflict(in, out))
+        {
+            if (entry.isDir)
+                skipped.insert(entry.path);
+            continue;
+        }
+
+        if (entry.isDir)
+        {
+            //dirs are made in order, before anything gets copied into them
+            ok = clone(in, out);
+            outDirs.insert(entry.path, out);
+            if (parallel)
+                queues.insert(entry.path, deviceSlots(in, out));
+        }
+        else if (!checkSpace())
+            ok = false;
+        else if (parallel && queues.contains(parent))
+        {
+            //blocks when this device pair already has enough files in flight
+            QSemaphore *queue = queues.value(parent);
+            queue->acquire();
+            m_pool->start(new CopyTask(this, in, out, queue));
+            ok = !hasFailed();
+        }
+        else
+            ok = clone(in, out);
     }
 
-    if (!clone(inFile, outFile))
-        return false;
+    if (!parallel)
+        return ok;
+
+    m_pool->waitForDone();
+    qDeleteAll(m_deviceSlots);
+    m_deviceSlots.clear();
+
+    QMutexLocker locker(&m_progressMtx);
+    if (m_failedIn.isEmpty())
+        return ok;
+    m_inFile = m_failedIn;
+    m_outFile = m_failedOut;
+    m_failedIn.clear();
+    m_failedOut.clear();
+    return false;
+}
+
+QSemaphore
+*Manager::deviceSlots(const QString &inDir, const QString &outDir)
+{
+    QString key;
+#if defined(ISUNIX)
+    struct stat inSt, outSt;
+    if (!stat(QFile::encodeName(inDir).constData(), &inSt) && !stat(QFile::encodeName(outDir).constData(), &outSt))
+        key = QString("%1:%2").arg(quint64(inSt.st_dev)).arg(quint64(outSt.st_dev));
+#else
+    Q_UNUSED(inDir);
+    Q_UNUSED(outDir);
+#endif
+    QSemaphore *queue = m_deviceSlots.value(key, 0);
+    if (!queue)
+    {
+        const int depth = qMax(1, Store::config.behaviour.copyQueueDepth);
+        queue = new QSemaphore(depth);
+        m_deviceSlots.insert(key, queue);
+        m_pool->setMaxThreadCount(depth*m_deviceSlots.count());
+    }
+    return queue;
+}
+
+bool
+Manager::hasFailed()
+{
+    QMutexLocker locker(&m_progressMtx);
+    return !m_failedIn.isEmpty();
+}
 
-    if (QFileInfo(inFile).isDir())
+void
+Manager::copyFailed(const QString &in, const QString &out)
+{
+    QMutexLocker locker(&m_progressMtx);
+    if (m_failedIn.isEmpty())
+    {
+        m_failedIn = in;
+        m_failedOut = out;
+    }
+}
+
+void
+Manager::setCurrent(const QString &in, const QString &out)
+{
+    QMutexLocker locker(&m_progressMtx);
+    m_inFile = in;
+    m_outFile = out;
+    m_fileProgress = 0;
+    m_inProgress = 0;
+}
+
+void
+Manager::addProgress(const quint64 bytes, const quint64 copied, const quint64 size)
+{
+    QMutexLocker locker(&m_progressMtx);
+    m_inProgress += bytes;
+    m_allProgress += bytes;
+    m_fileProgress = size ? copied*100/size : 100;
+}
+
+bool
+Manager::kernelCopy(const int fdIn, const int fdOut, const quint64 size, quint64 &copied)
+{
+#if defined(ISUNIX)
+#if defined(HASFICLONE)
+    //reflink, the filesystem just shares the extents (btrfs, xfs...)
+    if (!copied && ioctl(fdOut, FICLONE, fdIn) == 0)
     {
-        QDir inDir(inFile), outDir(outFile);
-        inDir.setFilter(allEntries);
-        QDirIterator dirIterator(inDir);
-        while (dirIterator.hasNext())
+        copied = size;
+        addProgress(size, copied, size);
+        return true;
+    }
+#endif
+    struct stat st;
+    if (fstat(fdIn, &st))
+        return false;
+    //fewer blocks than bytes means there are holes we want to keep
+    const bool sparse = quint64(st.st_blocks)*512 < size;
+#if defined(HASFALLOCATE)
+    if (!sparse && size)
+        fallocate(fdOut, FALLOC_FL_KEEP_SIZE, 0, size);
+#endif
+    static const quint64 chunk = 8*1048576; //so we can pause, cancel and report progress
+#if defined(HASCOPYFILERANGE)
+    bool canCopyRange = true;
+#endif
+    while (copied < size)
+    {
+        quint64 dataStart = copied, dataEnd = size;
+#if defined(HASSEEKDATA)
+        if (sparse)
         {
-            const QString &name = QFileInfo(dirIterator.next()).fileName();
-            if (!copyRecursive(inDir.absoluteFilePath(name) , outDir.absoluteFilePath(name), cut, sameDisk))
+            const off_t data = lseek(fdIn, copied, SEEK_DATA);
+            if (data == -1 && errno == ENXIO)
+                dataStart = size; //only a hole left
+            else if (data != -1)
+            {
+                dataStart = data;
+                const off_t hole = lseek(fdIn, dataStart, SEEK_HOLE);
+                if (hole != -1)
+                    dataEnd = hole;
+            }
+        }
+#endif
+        if (dataStart > copied)
+        {
+            addProgress(dataStart-copied, dataStart, size);
+            copied = dataStart;
+            continue;
+        }
+        while (copied < dataEnd)
+        {
+            pause();
+            if (m_canceled)
                 return false;
+            const size_t len = qMin(chunk, dataEnd-copied);
+            ssize_t n = -1;
+#if defined(HASCOPYFILERANGE)
+            if (canCopyRange)
+            {
+                loff_t offIn = copied, offOut = copied;
+                n = copy_file_range(fdIn, &offIn, fdOut, &offOut, len, 0);
+                if (n == -1)
+                    canCopyRange = false; //cross device on older kernels, try sendfile
+            }
+#endif
+#if defined(HASSENDFILE)
+            if (n == -1)
+            {
+                off_t offIn = copied;
+                if (lseek(fdOut, copied, SEEK_SET) != -1)
+                    n = sendfile(fdOut, fdIn, &offIn, len);
+            }
+#endif
+            if (n <= 0) //caller takes it from here the old way
+                return false;
+            copied += n;
+            addProgress(n, copied, size);
         }
     }
-    return true;
+    //a trailing hole doesnt get written at all
+    return !ftruncate(fdOut, size);
+#else
+    Q_UNUSED(fdIn);
+    Q_UNUSED(fdOut);
+    Q_UNUSED(size);
+    Q_UNUSED(copied);
+    return false;
+#endif
 }
 
 bool
 Manager::clone(const QString &in, const QString &out)
 {
-    m_inFile = in;
-    m_outFile = out;
+    setCurrent(in, out);
     if (m_canceled)
         return true;
     if (QFileInfo(in).isDir())
@@ -706,13 +995,34 @@ Manager::clone(const QString &in, const QString &out)
         return false;
 
     QFile fileOut(out);
-    fileOut.open(QIODevice::WriteOnly);
+    if (!fileOut.open(QIODevice::WriteOnly))
+        return false;
+
+    const quint64 totalSize = fileIn.size();
+    quint64 totalInBytes = 0;
+
+    //let the kernel do it if it can, whatever it didnt
+    //manage to copy we do below through a buffer.
+    if (kernelCopy(fileIn.handle(), fileOut.handle(), totalSize, totalInBytes))
+    {
+        fileIn.close();
+        fileOut.close();
+        return true;
+    }
+    if (m_canceled)
+    {
+        fileIn.close();
+        fileOut.close();
+        QFile::remove(out);
+        return true;
+    }
+    if (!fileIn.seek(totalInBytes) || !fileOut.seek(totalInBytes))
+        return false;
 
     QDataStream inData(&fileIn);
     QDataStream outData(&fileOut);
 
-    quint64 inBytes = 0, totalInBytes = 0, totalSize = fileIn.size();
-    m_fileProgress = m_inProgress = 0;
+    quint64 written = totalInBytes;
     char block[1048576]; //read/write 1 megabyte at a time
 
     while (!fileIn.atEnd())
@@ -725,17 +1035,18 @@ Manager::clone(const QString &in, const QString &out)
             QFile::remove(out);
             return true;
         }
-        inBytes = inData.readRawData(block, sizeof block);
-        m_inProgress += outData.writeRawData(block, inBytes);
-        m_allProgress += inBytes;
+        const int inBytes = inData.readRawData(block, sizeof block);
+        if (inBytes < 0)
+            break;
+        written += outData.writeRawData(block, inBytes);
         totalInBytes += inBytes;
-        m_fileProgress = totalInBytes*100/totalSize;
+        addProgress(inBytes, totalInBytes, totalSize);
     }
 
     fileIn.close();
     fileOut.close();
 
-    return bool(m_inProgress == totalInBytes);
+    return bool(written == totalInBytes);
 }
 
 bool
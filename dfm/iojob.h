@@ -41,9 +41,12 @@
 #include <QLineEdit>
 #include <QMutex>
 #include <QKeyEvent>
+#include <QThreadPool>
+#include <QSemaphore>
 #include "operations.h"
 #include "globals.h"
 #include "objects.h"
+#include "ioscanner.h"
 
 namespace DFM
 {
@@ -89,6 +92,7 @@ signals:
 
 public slots:
     void setInfo(QString from, QString to, int completeProgress, int currentProgress);
+    void setCounting(const bool counting);
     inline void setMove(const bool move) { m_cut = move; }
     inline void setSpeed(const QString &speed) { m_speedLabel->setText(speed); }
     void finished();
@@ -127,7 +131,7 @@ public:
     void queue(const IOJobData &ioJob);
 
 public slots:
-    inline void cancelCopy() { m_canceled = true; setPause(false); qDebug() << "cancelling copy..."; }
+    inline void cancelCopy() { m_canceled = true; m_scanner->cancel(); setPause(false); qDebug() << "cancelling copy..."; }
     void getMessage(const QStringList &message);
 
 signals:
@@ -139,6 +143,7 @@ signals:
     void speed(const QString &speed);
     void isMove(const bool move);
     void ioIsBusy(const bool isBusy);
+    void counting(const bool counting);
 
 private slots:
     void fileExistsSlot(const QStringList &files);
@@ -149,14 +154,21 @@ private slots:
     void ioBusy(const bool busy);
 
 protected:
-    bool copyRecursive(const QString &inFile, const QString &outFile, bool cut, bool sameDisk);
+    bool copyInventory(const QString &inFile, Inventory *inventory, const bool parallel);
+    bool resolveConflict(const QString &inFile, QString &outFile);
+    QSemaphore *deviceSlots(const QString &inDir, const QString &outDir);
+    void copyFailed(const QString &in, const QString &out);
+    bool hasFailed();
+    void setCurrent(const QString &in, const QString &out);
     bool clone(const QString &in, const QString &out);
+    bool kernelCopy(const int fdIn, const int fdOut, const quint64 size, quint64 &copied);
+    void addProgress(const quint64 bytes, const quint64 copied, const quint64 size);
     bool remove(const QString &path) const;
-    int currentProgress() { return m_allProgress*100/m_total; }
+    int currentProgress() { return m_total ? qMin<quint64>(100, m_allProgress*100/m_total) : 0; }
     void reset();
     void doJob(const IOJobData &ioJobData);
-    void getDirs(const QString &dir, quint64 &fileSize = (quint64 &)defaultInteger);
-    bool getTotalSize(const QStringList &copyFiles, quint64 &fileSize = (quint64 &)defaultInteger);
+    bool canCopy(const QStringList &copyFiles) const;
+    bool checkSpace();
     void error(const QString &error);
     IOJobData deqeueue();
     void run();
@@ -164,14 +176,21 @@ protected:
 private:
     QString m_destDir, m_inFile, m_newFile, m_outFile, m_errorString;
     bool m_cut, m_canceled;
-    quint64 m_total, m_allProgress, m_diffCheck;
+    quint64 m_total, m_allProgress, m_diffCheck, m_spaceChecked;
     mutable QMutex m_queueMtx;
     Mode m_mode;
-    int m_inProgress, m_fileProgress;
+    quint64 m_inProgress;
+    int m_fileProgress;
     QTimer *m_timer, *m_speedTimer;
     CopyDialog *m_copyDialog;
     QQueue<IOJobData> m_queue;
     IOJobData m_currentJob;
+    QThreadPool *m_pool;
+    QHash<QString, QSemaphore *> m_deviceSlots;
+    QMutex m_progressMtx;
+    QString m_failedIn, m_failedOut;
+    Scanner *m_scanner;
+    friend class CopyTask;
 };
 
 }
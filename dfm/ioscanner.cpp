@@ -0,0 +1,273 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+#include "ioscanner.h"
+#include "globals.h"
+
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFile>
+
+#if defined(HASGETDENTS)
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define BATCHSIZE 256
+
+using namespace DFM;
+using namespace IO;
+
+void
+Inventory::append(const QList<Entry> &entries)
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries += entries;
+    m_wait.wakeAll();
+}
+
+void
+Inventory::finish()
+{
+    QMutexLocker locker(&m_mutex);
+    m_done = true;
+    m_wait.wakeAll();
+}
+
+bool
+Inventory::isDone()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_done;
+}
+
+bool
+Inventory::at(const int i, Entry &entry)
+{
+    QMutexLocker locker(&m_mutex);
+    while (i >= m_entries.count() && !m_done)
+        m_wait.wait(&m_mutex);
+    if (i >= m_entries.count())
+        return false;
+    entry = m_entries.at(i);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+Scanner::Scanner(QObject *parent)
+    : QThread(parent)
+    , m_bytes(0)
+    , m_canceled(false)
+{
+}
+
+Scanner::~Scanner()
+{
+    cancel();
+    wait();
+}
+
+void
+Scanner::scan(const QStringList &files, const QList<Inventory *> &inventories)
+{
+    wait();
+    m_files = files;
+    m_inventories = inventories;
+    m_bytes = 0;
+    m_canceled = false;
+    start();
+}
+
+void
+Scanner::cancel()
+{
+    QMutexLocker locker(&m_mutex);
+    m_canceled = true;
+}
+
+bool
+Scanner::isCanceled() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_canceled;
+}
+
+quint64
+Scanner::bytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytes;
+}
+
+void
+Scanner::run()
+{
+    for (int i = 0; i < m_files.count(); ++i)
+    {
+        Inventory *inventory = m_inventories.at(i);
+        //done already means it is renamed, nothing to copy
+        if (!inventory->isDone() && !isCanceled())
+            scanFile(m_files.at(i), inventory);
+        //always finish, the manager might be waiting on it
+        inventory->finish();
+    }
+}
+
+void
+Scanner::add(const QString &rel, const quint64 size, const bool isDir, Inventory *inventory)
+{
+    Inventory::Entry entry;
+    entry.path = rel;
+    entry.size = size;
+    entry.isDir = isDir;
+    m_batch << entry;
+    if (size)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_bytes += size;
+    }
+    if (m_batch.count() >= BATCHSIZE)
+        flush(inventory);
+}
+
+void
+Scanner::flush(Inventory *inventory)
+{
+    if (m_batch.isEmpty())
+        return;
+    inventory->append(m_batch);
+    m_batch.clear();
+}
+
+void
+Scanner::scanFile(const QString &file, Inventory *inventory)
+{
+    const QFileInfo fi(file);
+    const QString &name = fi.fileName();
+    if (!fi.isDir())
+    {
+        add(name, fi.size(), false, inventory);
+        flush(inventory);
+        return;
+    }
+    add(name, 0, true, inventory);
+#if defined(HASGETDENTS)
+    const int fd = open(QFile::encodeName(file).constData(), O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if (fd != -1)
+    {
+        scanDir(fd, name, inventory);
+        close(fd);
+        flush(inventory);
+        return;
+    }
+#endif
+    scanDir(file, name, inventory);
+    flush(inventory);
+}
+
+void
+Scanner::scanDir(const QString &dir, const QString &rel, Inventory *inventory)
+{
+    QStringList dirs;
+    QDirIterator it(dir, allEntries);
+    while (it.hasNext())
+    {
+        it.next();
+        const QFileInfo &fi = it.fileInfo();
+        const QString &path = rel + QLatin1Char('/') + it.fileName();
+        if (fi.isDir())
+        {
+            add(path, 0, true, inventory);
+            dirs << it.fileName();
+        }
+        else
+            add(path, fi.size(), false, inventory);
+    }
+    //contents of subdirs after the subdirs themselves
+    for (int i = 0; i < dirs.count(); ++i)
+    {
+        if (isCanceled())
+            return;
+        scanDir(QString("%1/%2").arg(dir, dirs.at(i)), rel + QLatin1Char('/') + dirs.at(i), inventory);
+    }
+}
+
+#if defined(HASGETDENTS)
+
+//what getdents64 hands us, glibc doesnt export it everywhere
+struct LinuxDirent64
+{
+    quint64 ino;
+    qint64 off;
+    unsigned short reclen;
+    unsigned char type;
+    char name[1];
+};
+
+void
+Scanner::scanDir(const int fd, const QString &rel, Inventory *inventory)
+{
+    quint64 buf[2048]; //16k, aligned for the dirents
+    QList<QByteArray> dirs;
+    forever
+    {
+        const long n = syscall(SYS_getdents64, fd, buf, sizeof buf);
+        if (n <= 0)
+            break;
+        for (long pos = 0; pos < n;)
+        {
+            const LinuxDirent64 *d = reinterpret_cast<const LinuxDirent64 *>(reinterpret_cast<const char *>(buf)+pos);
+            pos += d->reclen;
+            const char *name = d->name;
+            if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+                continue;
+            //follow links like QFileInfo does, a broken one is just a file
+            struct stat st;
+            if (fstatat(fd, name, &st, 0) && fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW))
+                continue;
+            const QString &path = rel + QLatin1Char('/') + QFile::decodeName(name);
+            if (S_ISDIR(st.st_mode))
+            {
+                add(path, 0, true, inventory);
+                dirs << QByteArray(name);
+            }
+            else
+                add(path, st.st_size, false, inventory);
+        }
+        if (isCanceled())
+            return;
+    }
+    for (int i = 0; i < dirs.count(); ++i)
+    {
+        if (isCanceled())
+            return;
+        const int sub = openat(fd, dirs.at(i).constData(), O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+        if (sub == -1)
+            continue;
+        scanDir(sub, rel + QLatin1Char('/') + QFile::decodeName(dirs.at(i)), inventory);
+        close(sub);
+    }
+}
+
+#endif
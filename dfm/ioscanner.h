@@ -0,0 +1,97 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+
+#ifndef IOSCANNER_H
+#define IOSCANNER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+
+namespace DFM
+{
+namespace IO
+{
+
+/* Everything below one file or dir that is about
+ * to be copied, in an order where dirs always come
+ * before their contents. Filled by the Scanner while
+ * the Manager already copies what is known.
+ */
+
+class Inventory
+{
+public:
+    struct Entry
+    {
+        QString path; //relative to the parent of the copied file
+        quint64 size;
+        bool isDir;
+    };
+    Inventory() : m_done(false) {}
+    void append(const QList<Entry> &entries);
+    void finish();
+    bool isDone();
+    //blocks until entry i is scanned, false when there are no more
+    bool at(const int i, Entry &entry);
+
+private:
+    QList<Entry> m_entries;
+    bool m_done;
+    QMutex m_mutex;
+    QWaitCondition m_wait;
+};
+
+class Scanner : public QThread
+{
+    Q_OBJECT
+public:
+    explicit Scanner(QObject *parent = 0);
+    ~Scanner();
+    void scan(const QStringList &files, const QList<Inventory *> &inventories);
+    void cancel();
+    quint64 bytes() const;
+
+protected:
+    void run();
+    bool isCanceled() const;
+    void scanFile(const QString &file, Inventory *inventory);
+    void scanDir(const QString &dir, const QString &rel, Inventory *inventory);
+#if defined(HASGETDENTS)
+    void scanDir(const int fd, const QString &rel, Inventory *inventory);
+#endif
+    void add(const QString &rel, const quint64 size, const bool isDir, Inventory *inventory);
+    void flush(Inventory *inventory);
+
+private:
+    QStringList m_files;
+    QList<Inventory *> m_inventories;
+    QList<Inventory::Entry> m_batch;
+    quint64 m_bytes;
+    bool m_canceled;
+    mutable QMutex m_mutex;
+};
+
+}
+}
+
+#endif // IOSCANNER_H
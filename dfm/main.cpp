@@ -23,6 +23,7 @@
 #include "config.h"
 #include "iojob.h"
 #include "operations.h"
+#include "thumbcache.h"
 #include <typeinfo>
 //#include <dsp/settings.h>
 
@@ -79,6 +80,8 @@ int main(int argc, char *argv[])
 //    qDebug() << Settings::readVal(Settings::Inputgrad);
 
 
-    return app.exec();
+    const int ret = app.exec();
+    DFM::ThumbCache::shutdown();
+    return ret;
 }
 
@@ -434,6 +434,13 @@ MainWindow::updateStatusBar(const QUrl &url)
     m_statusBar->setMessage(m_statusMessage);
 }
 
+void
+MainWindow::prefetchRecent()
+{
+    if (ViewContainer *c = qobject_cast<ViewContainer *>(sender()))
+        c->model()->prefetch(m_recentFoldersView->folders(4));
+}
+
 void
 MainWindow::closeEvent(QCloseEvent *event)
 {
@@ -559,6 +566,7 @@ MainWindow::connectContainer(ViewContainer *container)
     connect(container, SIGNAL(urlChanged(QUrl)), this, SLOT(urlChanged(QUrl)));
     connect(container, SIGNAL(urlLoaded(QUrl)), this, SLOT(urlChanged(QUrl)));
     connect(container, SIGNAL(urlLoaded(QUrl)), this, SLOT(updateStatusBar(QUrl)));
+    connect(container, SIGNAL(urlLoaded(QUrl)), this, SLOT(prefetchRecent()));
     connect(container, SIGNAL(urlChanged(QUrl)), m_recentFoldersView, SLOT(folderEntered(QUrl)));
     connect(container, SIGNAL(viewChanged()), this, SLOT(checkViewAct()));
     connect(container, SIGNAL(selectionChanged()), this, SLOT(mainSelectionChanged()));
@@ -93,6 +93,7 @@ protected:
 
 private slots:
     void updateStatusBar(const QUrl &url);
+    void prefetchRecent();
     void updateIcons();
     void goHome();
     void goBack();
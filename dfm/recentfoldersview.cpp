@@ -127,6 +127,15 @@ RecentFoldersView::folderEntered(const QUrl &url)
     m_model->insertRow(0, item);
 }
 
+QStringList
+RecentFoldersView::folders(const int max) const
+{
+    QStringList folders;
+    for (int i = 0; i < m_model->rowCount() && folders.count() < max; ++i)
+        folders << m_model->item(i)->data().toString();
+    return folders;
+}
+
 void
 RecentFoldersView::itemActivated(const QModelIndex &index)
 {
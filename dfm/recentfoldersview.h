@@ -40,6 +40,7 @@ class RecentFoldersView : public QListView
     Q_OBJECT
 public:
     explicit RecentFoldersView(QWidget *parent = 0);
+    QStringList folders(const int max) const;
     
 signals:
     void recentFolderClicked(const QUrl &url);
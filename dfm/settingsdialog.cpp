@@ -24,6 +24,7 @@
 #include "mainwindow.h"
 #include "application.h"
 #include "interfaces.h"
+#include "fsmodel.h"
 #include <QGroupBox>
 #include <QFileDialog>
 #include <QToolButton>
@@ -50,6 +51,12 @@ BehaviourWidget::BehaviourWidget(QWidget *parent)
     , m_pathBarPlace(new QComboBox(this))
     , m_useIOQueue(new QCheckBox(tr("Queue IO operations (copy/move/delete)"), this))
     , m_showCloseTabButton(new QCheckBox(tr("Show closebutton for tabs"), this))
+    , m_copyQueueDepth(new QSpinBox(this))
+    , m_nodeCacheSize(new QSpinBox(this))
+    , m_dormantTimeout(new QSpinBox(this))
+    , m_searchOtherFs(new QCheckBox(tr("Search into other filesystems"), this))
+    , m_lazyStat(new QCheckBox(tr("Read file details only for shown files"), this))
+    , m_searchExcludes(new QLineEdit(this))
 {
     m_hideTabBar->setChecked(Store::config.behaviour.hideTabBarWhenOnlyOneTab);
     m_useCustomIcons->setChecked(Store::config.behaviour.systemIcons);
@@ -121,6 +128,24 @@ BehaviourWidget::BehaviourWidget(QWidget *parent)
 
     m_pathBarPlace->addItems(QStringList() << "Above views" << "Below views");
     m_pathBarPlace->setCurrentIndex(Store::config.behaviour.pathBarPlace);
+    m_copyQueueDepth->setRange(1, 64);
+    m_copyQueueDepth->setValue(Store::config.behaviour.copyQueueDepth);
+    m_copyQueueDepth->setToolTip(tr("How many files are copied at the same time between two devices, 1 copies one file at a time"));
+    m_nodeCacheSize->setRange(0, 100000);
+    m_nodeCacheSize->setSuffix(" k");
+    m_nodeCacheSize->setSpecialValueText(tr("Unlimited"));
+    m_nodeCacheSize->setValue(Store::config.behaviour.nodeCacheSize);
+    m_nodeCacheSize->setToolTip(tr("Thousands of files and folders kept in memory, folders not visited for a while are read again when needed"));
+    m_dormantTimeout->setRange(0, 1440);
+    m_dormantTimeout->setSuffix(" min");
+    m_dormantTimeout->setSpecialValueText(tr("Never"));
+    m_dormantTimeout->setValue(Store::config.behaviour.dormantTimeout);
+    m_dormantTimeout->setToolTip(tr("Tabs hidden this long stop watching their folder and free their memory until shown again"));
+    m_searchOtherFs->setChecked(Store::config.behaviour.searchOtherFs);
+    m_lazyStat->setChecked(Store::config.behaviour.lazyStat);
+    m_lazyStat->setToolTip(tr("Big or remote folders open faster, sorting by size, date or permissions still reads every file"));
+    m_searchExcludes->setText(Store::config.behaviour.searchExcludes.join(", "));
+    m_searchExcludes->setToolTip(tr("Comma separated names of folders that searching doesnt look into"));
 
     QGridLayout *gl = new QGridLayout(this);
     row = -1;
@@ -135,6 +160,16 @@ BehaviourWidget::BehaviourWidget(QWidget *parent)
     gl->addWidget(m_showCloseTabButton, ++row, 0, 1, 2);
     gl->addWidget(new QLabel(tr("PathBar position:")), ++row, 0, 1, 1);
     gl->addWidget(m_pathBarPlace, row, 1, 1, 1);
+    gl->addWidget(new QLabel(tr("Files copied in parallel:")), ++row, 0, 1, 1);
+    gl->addWidget(m_copyQueueDepth, row, 1, 1, 1);
+    gl->addWidget(new QLabel(tr("Entries kept in memory:")), ++row, 0, 1, 1);
+    gl->addWidget(m_nodeCacheSize, row, 1, 1, 1);
+    gl->addWidget(new QLabel(tr("Put hidden tabs to sleep after:")), ++row, 0, 1, 1);
+    gl->addWidget(m_dormantTimeout, row, 1, 1, 1);
+    gl->addWidget(m_lazyStat, ++row, 0, 1, 2);
+    gl->addWidget(m_searchOtherFs, ++row, 0, 1, 2);
+    gl->addWidget(new QLabel(tr("Skip when searching:")), ++row, 0, 1, 1);
+    gl->addWidget(m_searchExcludes, row, 1, 1, 1);
     gl->addWidget(m_tabsBox, ++row, 0, 1, 2);
     gl->addItem(new QSpacerItem(0, 0, QSizePolicy::Expanding, QSizePolicy::Expanding), ++row, 0);
     setLayout(gl);
@@ -217,11 +252,14 @@ ViewsWidget::ViewsWidget(QWidget *parent) : QWidget(parent)
   , m_categorized(new QCheckBox(tr("Show categorized"), this))
   , m_colWidth(new QSpinBox(this))
   , m_altRows(new QCheckBox(tr("Render rows with alternating colors"), this))
+  , m_thumbCacheSize(new QSpinBox(m_showThumbs))
+  , m_naturalSort(new QCheckBox(tr("Sort numbers in names by their value"), this))
 {
     m_categorized->setChecked(Store::config.views.iconView.categorized);
     m_showThumbs->setChecked(Store::config.views.showThumbs);
     m_singleClick->setChecked(Store::config.views.singleClick);
     m_dirSettings->setChecked(Store::config.views.dirSettings);
+    m_naturalSort->setChecked(Store::config.views.naturalSort);
     m_showThumbs->setEnabled(dApp->hasThumbIfaces());
     m_showThumbs->setCheckable(true);
 
@@ -237,6 +275,15 @@ ViewsWidget::ViewsWidget(QWidget *parent) : QWidget(parent)
             tL->addWidget(box);
         }
     }
+    m_thumbCacheSize->setRange(0, 65536);
+    m_thumbCacheSize->setSuffix(" MB");
+    m_thumbCacheSize->setSpecialValueText(tr("Disabled"));
+    m_thumbCacheSize->setValue(Store::config.views.thumbCacheSize);
+    QHBoxLayout *cL = new QHBoxLayout();
+    cL->addWidget(new QLabel(tr("Thumbnail cache on disk:"), m_showThumbs));
+    cL->addStretch();
+    cL->addWidget(m_thumbCacheSize);
+    tL->addLayout(cL);
 
     //IconView
     m_iconSlider->setRange(1, 16);
@@ -318,6 +365,7 @@ ViewsWidget::ViewsWidget(QWidget *parent) : QWidget(parent)
     vLayout->addWidget(m_showThumbs);
     vLayout->addWidget(m_singleClick);
     vLayout->addWidget(m_dirSettings);
+    vLayout->addWidget(m_naturalSort);
 
     vLayout->addLayout(defView);
     vLayout->addLayout(iconSize);
@@ -393,6 +441,7 @@ SettingsDialog::accept()
     Store::config.behaviour.hideTabBarWhenOnlyOneTab = m_behWidget->m_hideTabBar->isChecked();
     Store::config.behaviour.systemIcons = m_behWidget->m_useCustomIcons->isChecked();
     Store::config.views.showThumbs = m_viewWidget->m_showThumbs->isChecked();
+    Store::config.views.thumbCacheSize = m_viewWidget->m_thumbCacheSize->value();
     Store::config.behaviour.devUsage = m_behWidget->m_drawDevUsage->isChecked();
     Store::config.views.iconView.textWidth = m_viewWidget->m_iconWidth->value();
     Store::config.views.detailsView.rowPadding = m_viewWidget->m_rowPadding->value();
@@ -400,6 +449,8 @@ SettingsDialog::accept()
     Store::config.behaviour.view = m_viewWidget->m_viewBox->currentIndex();
     Store::config.views.iconView.iconSize = m_viewWidget->m_iconSlider->value();
     Store::config.views.singleClick = m_viewWidget->m_singleClick->isChecked();
+    const bool resort = Store::config.views.naturalSort != m_viewWidget->m_naturalSort->isChecked();
+    Store::config.views.naturalSort = m_viewWidget->m_naturalSort->isChecked();
     Store::config.views.iconView.lineCount = m_viewWidget->m_lineCount->value();
     Store::config.behaviour.capsContainers = m_behWidget->m_capsConts->isChecked();
     Store::config.views.dirSettings = m_viewWidget->m_dirSettings->isChecked();
@@ -409,7 +460,17 @@ SettingsDialog::accept()
     Store::config.views.detailsView.altRows = m_viewWidget->m_altRows->isChecked();
     Store::config.behaviour.pathBarPlace = m_behWidget->m_pathBarPlace->currentIndex();
     Store::config.behaviour.useIOQueue = m_behWidget->m_useIOQueue->isChecked();
+    Store::config.behaviour.copyQueueDepth = m_behWidget->m_copyQueueDepth->value();
+    Store::config.behaviour.nodeCacheSize = m_behWidget->m_nodeCacheSize->value();
+    Store::config.behaviour.dormantTimeout = m_behWidget->m_dormantTimeout->value();
     Store::config.behaviour.showCloseTabButton = m_behWidget->m_showCloseTabButton->isChecked();
+    Store::config.behaviour.searchOtherFs = m_behWidget->m_searchOtherFs->isChecked();
+    Store::config.behaviour.lazyStat = m_behWidget->m_lazyStat->isChecked();
+    QStringList excludes;
+    foreach (const QString &exclude, m_behWidget->m_searchExcludes->text().split(",", QString::SkipEmptyParts))
+        if (!exclude.trimmed().isEmpty())
+            excludes << exclude.trimmed();
+    Store::config.behaviour.searchExcludes = excludes;
 
     Store::settings()->setValue("behaviour.useIOQueue", Store::config.behaviour.useIOQueue);
     Store::settings()->setValue("behaviour.gayWindow", m_behWidget->m_tabsBox->isChecked());
@@ -424,7 +485,11 @@ SettingsDialog::accept()
 //    Store::settings()->setValue("behaviour.gayWindow.invertedColors", ???);
 
     if (MainWindow *mw = MainWindow::currentWindow())
+    {
+        if (resort)
+            mw->model()->sortNode();
         mw->updateConfig();
+    }
 
     QDialog::accept();
 }
@@ -68,8 +68,9 @@ private:
     friend class SettingsDialog;
     QGroupBox *m_tabsBox;
     QComboBox *m_tabShape, *m_layOrder, *m_pathBarPlace;
-    QSpinBox *m_tabRndns, *m_tabHeight, *m_tabWidth, *m_overlap;
-    QCheckBox *m_hideTabBar, *m_useCustomIcons, *m_drawDevUsage, *m_newTabButton, *m_capsConts, *m_invActBookm, *m_invAllBookm, *m_useIOQueue, *m_showCloseTabButton;
+    QSpinBox *m_tabRndns, *m_tabHeight, *m_tabWidth, *m_overlap, *m_copyQueueDepth, *m_nodeCacheSize, *m_dormantTimeout;
+    QCheckBox *m_hideTabBar, *m_useCustomIcons, *m_drawDevUsage, *m_newTabButton, *m_capsConts, *m_invActBookm, *m_invAllBookm, *m_useIOQueue, *m_showCloseTabButton, *m_searchOtherFs, *m_lazyStat;
+    QLineEdit *m_searchExcludes;
     StartupWidget *m_startUpWidget;
 };
 
@@ -85,11 +86,11 @@ private slots:
 
 private:
     friend class SettingsDialog;
-    QCheckBox *m_singleClick, *m_dirSettings, *m_categorized, *m_altRows;
+    QCheckBox *m_singleClick, *m_dirSettings, *m_categorized, *m_altRows, *m_naturalSort;
     QSlider *m_iconWidth, *m_iconSlider;
     QString m_iconWidthStr;
     QLabel *m_width, *m_size;
-    QSpinBox *m_rowPadding, *m_lineCount, *m_colWidth;
+    QSpinBox *m_rowPadding, *m_lineCount, *m_colWidth, *m_thumbCacheSize;
     QComboBox *m_viewBox;
     QGroupBox *m_showThumbs;
 };
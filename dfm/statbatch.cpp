@@ -0,0 +1,254 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+
+#include "statbatch.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+
+#if defined(ISUNIX)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif
+
+#if defined(HASURING)
+#include <QThreadStorage>
+#include <liburing.h>
+#define RINGDEPTH 256 //statx calls in flight at once
+#endif
+
+using namespace DFM;
+
+#if defined(ISUNIX)
+//the groups we are in besides the effective one, they dont
+//change while we run so they are asked for once
+struct Groups
+{
+    Groups()
+    {
+        const int n = getgroups(0, 0);
+        if (n > 0)
+        {
+            ids.resize(n);
+            if (getgroups(n, ids.data()) != n)
+                ids.clear();
+        }
+    }
+    QVector<gid_t> ids;
+};
+Q_GLOBAL_STATIC(Groups, s_groups)
+
+//owner, group and other straight from the mode, user is what
+//access() would answer for our effective ids, acls aside. root
+//reads and writes anything and executes what anyone may.
+static uint
+permissions(const uint mode, const uint uid, const uint gid)
+{
+    const uint owner = (mode>>6)&7, group = (mode>>3)&7, other = mode&7;
+    uint user;
+    if (!geteuid())
+        user = 6 | ((S_ISDIR(mode) || (mode & 0111)) ? 1 : 0);
+    else if (uid == geteuid())
+        user = owner;
+    else if (gid == getegid() || s_groups()->ids.contains(gid))
+        user = group;
+    else
+        user = other;
+    return owner<<12 | user<<8 | group<<4 | other;
+}
+
+static void
+fail(StatBatch::Result &result, const int error)
+{
+    result.error = error;
+    result.gone = error == ENOENT || error == ENOTDIR;
+}
+#endif
+
+void
+StatBatch::stat(const QStringList &files, Results &results)
+{
+    results.clear();
+    results.resize(files.count());
+    QList<QByteArray> encoded;
+    for (int i = 0; i < files.count(); ++i)
+        encoded << QFile::encodeName(files.at(i));
+#if defined(HASURING)
+    //a couple of files are not worth a round trip through the ring
+    if (encoded.count() > 8 && statUring(encoded, results))
+        return;
+#endif
+    for (int i = 0; i < encoded.count(); ++i)
+        statPlain(encoded.at(i), results[i]);
+}
+
+void
+StatBatch::statPlain(const QByteArray &file, Result &result)
+{
+#if defined(ISUNIX)
+    struct stat st;
+    if (::stat(file.constData(), &st))
+    {
+        fail(result, errno);
+        return;
+    }
+#if defined(Q_OS_LINUX)
+    result.stamp.mtime = qint64(st.st_mtim.tv_sec)*Q_INT64_C(1000000000) + st.st_mtim.tv_nsec;
+#else
+    result.stamp.mtime = qint64(st.st_mtime)*Q_INT64_C(1000000000);
+#endif
+    result.stamp.size = st.st_size;
+    result.stamp.inode = st.st_ino;
+    result.perms = permissions(st.st_mode, st.st_uid, st.st_gid);
+    result.isDir = S_ISDIR(st.st_mode);
+#else
+    const QFileInfo fi(QFile::decodeName(file));
+    if (!fi.exists())
+    {
+        result.error = 1;
+        result.gone = true;
+        return;
+    }
+    result.stamp.mtime = fi.lastModified().toMSecsSinceEpoch()*Q_INT64_C(1000000);
+    result.stamp.size = fi.size();
+    result.perms = fi.permissions();
+    result.isDir = fi.isDir();
+#endif
+}
+
+#if defined(HASURING)
+//one ring per thread, set up on first use and kept until the
+//thread ends. the statx buffers belong to the ring so nothing
+//the kernel might still write to goes away under it.
+struct Ring
+{
+    Ring() : inFlight(0), bufs(new struct statx[RINGDEPTH])
+    {
+        isInit = usable = io_uring_queue_init(RINGDEPTH, &ring, 0) >= 0;
+    }
+    ~Ring()
+    {
+        if (inFlight) //couldnt reap them, leave ring and buffers be
+            return;
+        if (isInit)
+            io_uring_queue_exit(&ring);
+        delete [] bufs;
+    }
+    struct io_uring ring;
+    bool isInit, usable;
+    int inFlight;
+    struct statx *bufs;
+};
+static QThreadStorage<Ring *> s_rings;
+
+//false when there is no ring to be had, everything the
+//ring couldnt answer is done by statPlain() in here
+bool
+StatBatch::statUring(const QList<QByteArray> &files, Results &results)
+{
+    if (!s_rings.hasLocalData())
+        s_rings.setLocalData(new Ring());
+    Ring *r = s_rings.localData();
+    if (!r->usable)
+        return false;
+    struct io_uring *ring = &r->ring;
+    bool done[RINGDEPTH];
+    const int count = files.count();
+    for (int first = 0; first < count; first += RINGDEPTH)
+    {
+        const int n = qMin(RINGDEPTH, count-first);
+        for (int i = 0; i < n; ++i)
+        {
+            done[i] = false;
+            struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+            io_uring_prep_statx(sqe, AT_FDCWD, files.at(first+i).constData(), 0, STATX_BASIC_STATS, &r->bufs[i]);
+            io_uring_sqe_set_data(sqe, reinterpret_cast<void *>(quintptr(i)));
+        }
+        const int submitted = io_uring_submit(ring);
+        r->inFlight = qMax(0, submitted);
+        //whatever wasnt taken is still queued and would go out with
+        //the next submit, so this ring is done after this round
+        if (submitted != n)
+            r->usable = false;
+        //every request we handed over is reaped before we touch
+        //the buffers again or return, they are written until then
+        while (r->inFlight)
+        {
+            struct io_uring_cqe *cqe;
+            const int err = io_uring_wait_cqe(ring, &cqe);
+            if (err == -EINTR || err == -EAGAIN)
+                continue;
+            if (err < 0)
+            {
+                r->usable = false;
+                break;
+            }
+            --r->inFlight;
+            const int slot = int(quintptr(io_uring_cqe_get_data(cqe)));
+            const int res = cqe->res;
+            io_uring_cqe_seen(ring, cqe);
+            done[slot] = true;
+            Result &result = results[first+slot];
+            if (res == -EINVAL) //kernel without statx in the ring
+                statPlain(files.at(first+slot), result);
+            else if (res < 0)
+                fail(result, -res);
+            else
+            {
+                const struct statx &stx = r->bufs[slot];
+                result.stamp.mtime = qint64(stx.stx_mtime.tv_sec)*Q_INT64_C(1000000000) + stx.stx_mtime.tv_nsec;
+                result.stamp.size = stx.stx_size;
+                result.stamp.inode = stx.stx_ino;
+                result.perms = permissions(stx.stx_mode, stx.stx_uid, stx.stx_gid);
+                result.isDir = S_ISDIR(stx.stx_mode);
+            }
+        }
+        if (r->usable)
+            continue;
+        //the ring gave up on us, the rest goes plain
+        for (int i = 0; i < n; ++i)
+            if (!done[i])
+                statPlain(files.at(first+i), results[first+i]);
+        for (int i = first+n; i < count; ++i)
+            statPlain(files.at(i), results[i]);
+        return true;
+    }
+    return true;
+}
+#endif
+
+bool
+StatBatch::hasUring()
+{
+#if defined(HASURING)
+    struct io_uring ring;
+    if (io_uring_queue_init(2, &ring, 0) < 0)
+        return false;
+    io_uring_queue_exit(&ring);
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,67 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+
+#ifndef STATBATCH_H
+#define STATBATCH_H
+
+#include <QStringList>
+#include <QVector>
+
+#include "helpers.h"
+
+namespace DFM
+{
+
+/* Stats a list of files in one go. With io_uring the statx
+ * calls of a whole batch are in flight together so a slow
+ * disk or a network filesystem works on them in parallel,
+ * without it, or when the kernel wont give us a ring, they
+ * are done one after the other with plain syscalls.
+ */
+
+class StatBatch
+{
+public:
+    struct Result
+    {
+        Result() : perms(0), isDir(false), gone(false), error(0) {}
+        inline bool exists() const { return !error; }
+        FileStamp stamp;
+        uint perms; //QFile::Permissions, the user bits for our effective ids
+        bool isDir;
+        bool gone; //not there anymore, other errors keep what we knew
+        int error;
+    };
+    typedef QVector<Result> Results;
+
+    static void stat(const QStringList &files, Results &results);
+    static bool hasUring();
+
+protected:
+    static void statPlain(const QByteArray &file, Result &result);
+#if defined(HASURING)
+    static bool statUring(const QList<QByteArray> &files, Results &results);
+#endif
+};
+
+}
+
+#endif // STATBATCH_H
@@ -0,0 +1,297 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+#include <QDir>
+#include <QFile>
+#include <QUrl>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QTextStream>
+
+#include "thumbcache.h"
+#include "config.h"
+
+#if defined(ISUNIX)
+#include <sys/types.h>
+#include <utime.h>
+#endif
+
+#define INDEXSAVE 64 //writes before the index goes to disk again
+
+using namespace DFM;
+
+//where the thumbnails and our index of them live, worked
+//out once as every pool thread asks at the same time
+struct CachePaths
+{
+    CachePaths()
+    {
+        QString xdgCacheHome = QFile::decodeName(qgetenv("XDG_CACHE_HOME"));
+        if (xdgCacheHome.isEmpty())
+            xdgCacheHome = QString("%1/.cache").arg(QDir::homePath());
+        thumbnails = QString("%1/thumbnails").arg(xdgCacheHome);
+        index = QString("%1/dfm/thumbnails").arg(xdgCacheHome);
+    }
+    QString thumbnails, index;
+};
+Q_GLOBAL_STATIC(CachePaths, s_paths)
+
+ThumbCache *ThumbCache::s_instance = 0;
+QMutex ThumbCache::s_instanceMutex;
+bool ThumbCache::s_isShutDown = false;
+
+ThumbCache::ThumbCache(QObject *parent)
+    : QThread(parent)
+    , m_cacheSize(0)
+    , m_unsaved(0)
+    , m_quit(false)
+{
+    setPriority(QThread::LowPriority);
+    start();
+}
+
+ThumbCache::~ThumbCache()
+{
+    m_mutex.lock();
+    m_quit = true;
+    m_mutex.unlock();
+    m_wait.wakeAll();
+    wait();
+}
+
+ThumbCache
+*ThumbCache::instance()
+{
+    QMutexLocker locker(&s_instanceMutex);
+    if (!s_instance && !s_isShutDown)
+        s_instance = new ThumbCache();
+    return s_instance;
+}
+
+//on the way out, writes what is still queued and joins the thread
+void
+ThumbCache::shutdown()
+{
+    s_instanceMutex.lock();
+    ThumbCache *tc = s_instance;
+    s_instance = 0;
+    s_isShutDown = true;
+    s_instanceMutex.unlock();
+    delete tc;
+}
+
+QString
+ThumbCache::cacheDir(const int size)
+{
+    return QString("%1/%2").arg(s_paths()->thumbnails, size > 128 ? "large" : "normal");
+}
+
+QString
+ThumbCache::thumbFile(const QString &file, const int size)
+{
+    const QByteArray &uri = QUrl::fromLocalFile(file).toEncoded();
+    const QString &md5 = QCryptographicHash::hash(uri, QCryptographicHash::Md5).toHex();
+    return QString("%1/%2.png").arg(cacheDir(size), md5);
+}
+
+bool
+ThumbCache::thumb(const QString &file, const uint mtime, const int size, QImage &image)
+{
+    if (!Store::config.views.thumbCacheSize)
+        return false;
+
+    const QString &tf = thumbFile(file, size);
+    QImage img;
+    if (!img.load(tf, "PNG"))
+        return false;
+    if (img.text("Thumb::MTime").toUInt() != mtime)
+        return false;
+#if defined(ISUNIX)
+    //the cache is evicted least recently used first,
+    //and the file time is what tells when it was used...
+    utime(QFile::encodeName(tf).constData(), 0);
+#endif
+    image = img;
+    return true;
+}
+
+void
+ThumbCache::store(const QString &file, const uint mtime, const int size, const QImage &image)
+{
+    if (!Store::config.views.thumbCacheSize || image.isNull())
+        return;
+    //never thumbnail the thumbnails...
+    if (file.startsWith(cacheDir(size)))
+        return;
+
+    Job job;
+    job.file = file;
+    job.thumbFile = thumbFile(file, size);
+    job.mtime = mtime;
+    job.image = image;
+
+    //held until queued, shutdown() cant delete the cache under us
+    QMutexLocker locker(&s_instanceMutex);
+    if (s_isShutDown)
+        return;
+    if (!s_instance)
+        s_instance = new ThumbCache();
+    ThumbCache *tc = s_instance;
+    tc->m_mutex.lock();
+    tc->m_queue.enqueue(job);
+    tc->m_mutex.unlock();
+    tc->m_wait.wakeOne();
+}
+
+void
+ThumbCache::run()
+{
+    loadIndex();
+    forever
+    {
+        m_mutex.lock();
+        while (m_queue.isEmpty() && !m_quit)
+            m_wait.wait(&m_mutex);
+        if (m_queue.isEmpty()) //quitting, but only once everything is written
+        {
+            m_mutex.unlock();
+            saveIndex();
+            return;
+        }
+        const Job job = m_queue.dequeue();
+        m_mutex.unlock();
+        write(job.file, job.mtime, job.thumbFile, job.image);
+    }
+}
+
+void
+ThumbCache::write(const QString &file, const uint mtime, const QString &thumbFile, const QImage &image)
+{
+    const QFileInfo fi(thumbFile);
+    const QString &dir = fi.path();
+    if (!QFileInfo(dir).isDir())
+    {
+        QDir().mkpath(dir);
+        QFile::setPermissions(dir, QFile::ReadOwner|QFile::WriteOwner|QFile::ExeOwner);
+    }
+
+    QImage img(image);
+    img.setText("Thumb::URI", QUrl::fromLocalFile(file).toEncoded());
+    img.setText("Thumb::MTime", QString::number(mtime));
+    img.setText("Software", "dfm");
+
+    //write to a temporary file and rename as
+    //the spec says, readers never see half a png.
+    const QString &tmp = QString("%1.dfm-%2").arg(thumbFile, QString::number((quintptr)QThread::currentThreadId()));
+    if (!img.save(tmp, "PNG"))
+    {
+        QFile::remove(tmp);
+        return;
+    }
+    QFile::setPermissions(tmp, QFile::ReadOwner|QFile::WriteOwner);
+    const qint64 oldSize = m_own.value(thumbFile, 0); //only ours is counted
+    QFile::remove(thumbFile);
+    if (!QFile::rename(tmp, thumbFile))
+    {
+        QFile::remove(tmp);
+        m_own.remove(thumbFile);
+        m_cacheSize -= oldSize;
+        return;
+    }
+
+    const qint64 size = QFileInfo(thumbFile).size();
+    m_own.insert(thumbFile, size);
+    m_cacheSize += size-oldSize;
+    if (++m_unsaved >= INDEXSAVE)
+        saveIndex();
+
+    if (m_cacheSize > qint64(Store::config.views.thumbCacheSize)*1048576)
+        evict();
+}
+
+void
+ThumbCache::evict()
+{
+    //drop our least recently used thumbnails until we are at 90%
+    //of the limit, so we dont have to do this on every write.
+    //the file time is what tells, thumb() touches it on every hit.
+    const qint64 target = qint64(Store::config.views.thumbCacheSize)*1048576/10*9;
+    QList<QPair<qint64, QString> > byUse;
+    m_cacheSize = 0;
+    for (QHash<QString, qint64>::iterator it = m_own.begin(); it != m_own.end();)
+    {
+        const QFileInfo fi(it.key());
+        if (!fi.exists()) //someone else cleaned up
+        {
+            it = m_own.erase(it);
+            continue;
+        }
+        byUse << qMakePair(fi.lastModified().toMSecsSinceEpoch(), it.key());
+        m_cacheSize += it.value();
+        ++it;
+    }
+    qSort(byUse);
+    for (int i = 0; i < byUse.count() && m_cacheSize > target; ++i)
+        if (QFile::remove(byUse.at(i).second))
+            m_cacheSize -= m_own.take(byUse.at(i).second);
+    saveIndex();
+}
+
+//one thumbnail per line, its size and where it is
+void
+ThumbCache::loadIndex()
+{
+    m_own.clear();
+    m_cacheSize = 0;
+    QFile f(s_paths()->index);
+    if (!f.open(QFile::ReadOnly))
+        return;
+    QTextStream in(&f);
+    while (!in.atEnd())
+    {
+        const QString &line = in.readLine();
+        const int space = line.indexOf(' ');
+        if (space < 1)
+            continue;
+        const qint64 size = line.left(space).toLongLong();
+        m_own.insert(line.mid(space+1), size);
+        m_cacheSize += size;
+    }
+}
+
+void
+ThumbCache::saveIndex()
+{
+    m_unsaved = 0;
+    const QString &index = s_paths()->index;
+    QDir().mkpath(QFileInfo(index).path());
+    const QString &tmp = QString("%1.tmp").arg(index);
+    QFile f(tmp);
+    if (!f.open(QFile::WriteOnly|QFile::Truncate))
+        return;
+    QTextStream out(&f);
+    for (QHash<QString, qint64>::const_iterator it = m_own.constBegin(); it != m_own.constEnd(); ++it)
+        out << it.value() << ' ' << it.key() << '\n';
+    out.flush();
+    f.close();
+    QFile::remove(index);
+    QFile::rename(tmp, index);
+}
@@ -0,0 +1,87 @@
+/**************************************************************************
+*   Copyright (C) 2013 by Robert Metsaranta                               *
+*   therealestrob@gmail.com                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+***************************************************************************/
+
+
+#ifndef THUMBCACHE_H
+#define THUMBCACHE_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QImage>
+#include <QHash>
+
+namespace DFM
+{
+
+/* Thumbnails stored on disk as described in the
+ * freedesktop thumbnail spec, so they are shared
+ * between sessions and with other applications.
+ * Lookups are done synchronously by the caller,
+ * writing and evicting happens in this thread.
+ * Only thumbnails we wrote count towards the size
+ * limit and get evicted, the rest is left alone. What
+ * we wrote is kept in an index of our own so the shared
+ * dir never has to be read to tell.
+ */
+
+class ThumbCache : public QThread
+{
+    Q_OBJECT
+public:
+    static ThumbCache *instance();
+    static bool thumb(const QString &file, const uint mtime, const int size, QImage &image);
+    static void store(const QString &file, const uint mtime, const int size, const QImage &image);
+    static void shutdown();
+
+protected:
+    explicit ThumbCache(QObject *parent = 0);
+    ~ThumbCache();
+    void run();
+    void write(const QString &file, const uint mtime, const QString &thumbFile, const QImage &image);
+    void evict();
+    void loadIndex();
+    void saveIndex();
+    static QString cacheDir(const int size);
+    static QString thumbFile(const QString &file, const int size);
+
+private:
+    struct Job
+    {
+        QString file, thumbFile;
+        uint mtime;
+        QImage image;
+    };
+    QQueue<Job> m_queue;
+    QMutex m_mutex;
+    QWaitCondition m_wait;
+    QHash<QString, qint64> m_own; //thumbnails we wrote and their sizes, writer thread only
+    qint64 m_cacheSize;
+    int m_unsaved;
+    bool m_quit;
+    static ThumbCache *s_instance;
+    static QMutex s_instanceMutex;
+    static bool s_isShutDown;
+};
+
+}
+
+#endif // THUMBCACHE_H
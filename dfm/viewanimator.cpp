@@ -52,6 +52,9 @@ ViewAnimator::indexHovered(const QModelIndex &index)
     if (index.isValid() && index != m_current && index.flags() & Qt::ItemIsEnabled)
     {
         m_current = index;
+        //a hovered dir is the best guess for where the user goes next
+        if (FS::Model *model = qobject_cast<FS::Model *>(m_view->model()))
+            model->prefetch(index);
         if (!m_vals.contains(m_current))
             m_vals.insert(m_current, 0);
         if (!m_timer->isActive())
@@ -31,6 +31,9 @@
 #include <QMessageBox>
 #include <QStyledItemDelegate>
 #include <QMenu>
+#include <QTimer>
+#include <QShowEvent>
+#include <QHideEvent>
 
 #include "viewcontainer.h"
 #include "iconview.h"
@@ -38,6 +41,7 @@
 #include "flowview.h"
 #include "flow.h"
 #include "fsmodel.h"
+#include "fsnode.h"
 #include "pathnavigator.h"
 #include "operations.h"
 #include "iojob.h"
@@ -62,11 +66,12 @@ ViewContainer::ViewContainer(QWidget *parent)
     , m_currentView(Icon)
     , m_back(false)
     , m_selectModel(0)
+    , m_iconSize(Store::config.views.iconView.iconSize*16)
+    , m_sleepTimer(new QTimer(this))
 {
-    m_view[Icon] = new IconView(this);
-    m_view[Details] = new DetailsView(this);
-    m_view[Column] = new ColumnView(this);
-    m_view[Flow] = new FlowView(this);
+    //views are made when first shown, most tabs only ever use one
+    for (int i = 0; i < NViews; ++i)
+        m_view[i] = 0;
 
     m_model = new FS::Model(this);
     m_selectModel = new QItemSelectionModel(m_model);
@@ -89,27 +94,15 @@ ViewContainer::ViewContainer(QWidget *parent)
 
     connect(m_selectModel, SIGNAL(selectionChanged(QItemSelection,QItemSelection)), this, SIGNAL(selectionChanged()));
 
-    connect(iconView(), SIGNAL(iconSizeChanged(int)), this, SIGNAL(iconSizeChanged(int)));
-    connect(flowView()->flow(), SIGNAL(centerIndexChanged(QModelIndex)), this, SIGNAL(entered(QModelIndex)));
-
-    connect(iconView(), SIGNAL(newTabRequest(QModelIndex)), this, SLOT(genNewTabRequest(QModelIndex)));
-    connect(detailsView(), SIGNAL(newTabRequest(QModelIndex)), this, SLOT(genNewTabRequest(QModelIndex)));
-    connect(columnView(), SIGNAL(newTabRequest(QModelIndex)), this, SLOT(genNewTabRequest(QModelIndex)));
-    connect(flowView(), SIGNAL(newTabRequest(QModelIndex)), this, SLOT(genNewTabRequest(QModelIndex)));
+    //tabs not shown for a while go dormant, this one
+    //might never be shown at all so the clock starts now
+    m_sleepTimer->setSingleShot(true);
+    connect(m_sleepTimer, SIGNAL(timeout()), this, SLOT(sleep()));
+    startSleepTimer();
 
     m_viewStack = new QStackedLayout();
     m_viewStack->setSpacing(0);
     m_viewStack->setContentsMargins(0,0,0,0);
-    for (int i = 0; i < NViews; ++i)
-    {
-        connect(m_view[i], SIGNAL(entered(QModelIndex)), this, SIGNAL(entered(QModelIndex)));
-        connect(m_view[i], SIGNAL(viewportEntered()), this, SIGNAL(viewportEntered()));
-        connect(m_view[i], SIGNAL(opened(const QModelIndex &)), this, SLOT(activate(const QModelIndex &)));
-        m_viewStack->addWidget(m_view[i]);
-        m_view[i]->setMouseTracking(true);
-        m_view[i]->setModel(m_model);
-        m_view[i]->setSelectionModel(m_selectModel);
-    }
     m_layout = new QVBoxLayout();
     m_layout->setSpacing(0);
     m_layout->setContentsMargins(0,0,0,0);
@@ -124,6 +117,7 @@ ViewContainer::ViewContainer(QWidget *parent)
 
 ViewContainer::~ViewContainer()
 {
+    m_model->dispose();
 }
 
 void
@@ -142,9 +136,61 @@ FS::Model *ViewContainer::model() { return m_model; }
 
 QItemSelectionModel *ViewContainer::selectionModel() { return m_selectModel; }
 
+QAbstractItemView
+*ViewContainer::createView(const View view)
+{
+    QAbstractItemView *v = 0;
+    switch (view)
+    {
+    case Icon:
+    {
+        IconView *iv = new IconView(this);
+        connect(iv, SIGNAL(iconSizeChanged(int)), this, SIGNAL(iconSizeChanged(int)));
+        if (iv->iconSize().width() != m_iconSize)
+            iv->setNewSize(m_iconSize);
+        v = iv;
+        break;
+    }
+    case Details: v = new DetailsView(this); break;
+    case Column: v = new ColumnView(this); break;
+    case Flow:
+    {
+        FlowView *fv = new FlowView(this);
+        connect(fv->flow(), SIGNAL(centerIndexChanged(QModelIndex)), this, SIGNAL(entered(QModelIndex)));
+        v = fv;
+        break;
+    }
+    default: return 0;
+    }
+    if (view != Icon)
+    {
+        v->setIconSize(QSize(m_iconSize, m_iconSize));
+        QList<QAbstractItemView *> kids(v->findChildren<QAbstractItemView *>());
+        for (int i = 0; i < kids.count(); ++i)
+            kids.at(i)->setIconSize(QSize(m_iconSize, m_iconSize));
+    }
+    connect(v, SIGNAL(newTabRequest(QModelIndex)), this, SLOT(genNewTabRequest(QModelIndex)));
+    connect(v, SIGNAL(entered(QModelIndex)), this, SIGNAL(entered(QModelIndex)));
+    connect(v, SIGNAL(viewportEntered()), this, SIGNAL(viewportEntered()));
+    connect(v, SIGNAL(opened(const QModelIndex &)), this, SLOT(activate(const QModelIndex &)));
+    m_viewStack->addWidget(v);
+    v->setMouseTracking(true);
+    v->setModel(m_model);
+    v->setSelectionModel(m_selectModel);
+    //catch up with where the other views are
+    if (QAbstractItemView *cv = m_view[m_currentView])
+        v->setRootIndex(cv->rootIndex());
+    else if (m_model->rootUrl().isValid())
+        v->setRootIndex(m_model->index(m_model->rootUrl()));
+    m_view[view] = v;
+    return v;
+}
+
 void
 ViewContainer::setView(const View view, bool store)
 {
+    if (!m_view[view])
+        createView(view);
     m_currentView = view;
     m_viewStack->setCurrentWidget(m_view[view]);
     emit viewChanged();
@@ -164,10 +210,13 @@ ViewContainer::activate(const QModelIndex &index)
 void
 ViewContainer::setUrl(const QUrl &url)
 {
-    setRootIndex(m_model->index(url));
-    const QFileInfo &file = url.toLocalFile();
-    if (url.isLocalFile() && file.exists())
+    const QModelIndex &root = m_model->index(url);
+    setRootIndex(root);
+    //the node is already gathered, a placeholder isnt a dir
+    const FS::Node *node = root.isValid() ? m_model->node(root) : 0;
+    if (url.isLocalFile() && node && node->isDirectory())
     {
+        const QFileInfo &file = url.toLocalFile();
         if (Store::config.views.dirSettings)
         {
             bool ok;
@@ -175,7 +224,8 @@ ViewContainer::setUrl(const QUrl &url)
             if (ok)
                 setView(view, false);
         }
-        detailsView()->setItemsExpandable(false);
+        if (m_view[Details])
+            detailsView()->setItemsExpandable(false);
         m_selectModel->clearSelection();
     }
 }
@@ -183,7 +233,8 @@ ViewContainer::setUrl(const QUrl &url)
 void
 ViewContainer::loadedUrl(const QUrl &url)
 {
-    detailsView()->setItemsExpandable(true);
+    if (m_view[Details])
+        detailsView()->setItemsExpandable(true);
 }
 
 void
@@ -332,7 +383,8 @@ void
 ViewContainer::setRootIndex(const QModelIndex &index)
 {
     for (int i = 0; i < NViews; ++i)
-        m_view[i]->setRootIndex(index);
+        if (m_view[i])
+            m_view[i]->setRootIndex(index);
 }
 
 void
@@ -370,9 +422,13 @@ void ViewContainer::setPathEditable(const bool editable) { m_navBar->setEditable
 
 void ViewContainer::setIconSize(int stop)
 {
-    iconView()->setNewSize(stop);
+    m_iconSize = stop;
+    if (m_view[Icon])
+        iconView()->setNewSize(stop);
     for (int i = 1; i < NViews; ++i)
     {
+        if (!m_view[i])
+            continue;
         m_view[i]->setIconSize(QSize(stop, stop));
         QList<QAbstractItemView *> kids(m_view[i]->findChildren<QAbstractItemView *>());
         for (int i = 0; i < kids.count(); ++i)
@@ -380,4 +436,46 @@ void ViewContainer::setIconSize(int stop)
     }
 }
 
-const QSize ViewContainer::iconSize() const { return m_view[Icon]->iconSize(); }
+const QSize ViewContainer::iconSize() const { return m_view[Icon] ? m_view[Icon]->iconSize() : QSize(m_iconSize, m_iconSize); }
+
+void
+ViewContainer::startSleepTimer()
+{
+    if (Store::config.behaviour.dormantTimeout > 0)
+        m_sleepTimer->start(Store::config.behaviour.dormantTimeout*60000);
+}
+
+void
+ViewContainer::sleep()
+{
+    if (isVisible() || !m_model->sleep())
+    {
+        startSleepTimer(); //busy loading, try again later
+        return;
+    }
+    //only the view we come back to is kept, the others are made again when asked for
+    for (int i = 0; i < NViews; ++i)
+        if (i != m_currentView && m_view[i])
+        {
+            m_viewStack->removeWidget(m_view[i]);
+            m_view[i]->deleteLater();
+            m_view[i] = 0;
+        }
+}
+
+void
+ViewContainer::showEvent(QShowEvent *event)
+{
+    m_sleepTimer->stop();
+    m_model->wake();
+    QWidget::showEvent(event);
+}
+
+void
+ViewContainer::hideEvent(QHideEvent *event)
+{
+    //a minimized window hides spontaneously, that tab is still in use
+    if (!event->spontaneous())
+        startSleepTimer();
+    QWidget::hideEvent(event);
+}
@@ -30,6 +30,7 @@ class QVBoxLayout;
 class QItemSelectionModel;
 class QModelIndex;
 class QAbstractItemView;
+class QTimer;
 namespace DFM
 {
 class Button;
@@ -83,6 +84,10 @@ public:
 
 protected:
     void leaveEvent(QEvent *) { emit leftView(); }
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+    QAbstractItemView *createView(const View view);
+    void startSleepTimer();
 
 signals:
     void viewChanged();
@@ -110,6 +115,7 @@ private slots:
     void genNewTabRequest(const QModelIndex &index);
     void loadedUrl(const QUrl &url);
     void loadSettings();
+    void sleep();
 
 private:
     bool m_back;
@@ -121,6 +127,8 @@ private:
     NavBar *m_navBar;
     QVBoxLayout *m_layout;
     QAbstractItemView *m_view[NViews];
+    int m_iconSize;
+    QTimer *m_sleepTimer;
 };
 
 }
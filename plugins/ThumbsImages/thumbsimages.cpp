@@ -60,8 +60,8 @@ bool
 ThumbsImages::thumb(const QString &file, const QString &mime, QImage &thumb, const int size)
 {
     Q_UNUSED(mime);
-    static QImageReader ir;
-    ir.setFileName(file);
+    //one reader per call, we get called from several threads at once.
+    QImageReader ir(file);
     if (!ir.canRead())
         return false;
 
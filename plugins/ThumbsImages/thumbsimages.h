@@ -18,6 +18,7 @@ public:
     QString name() const;
     QString description() const;
     bool thumb(const QString &file, const QString &mime, QImage &thumb, const int size);
+    bool isThreadSafe() const { return true; }
 };
 
 